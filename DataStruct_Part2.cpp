@@ -4,78 +4,836 @@
 #include <sstream>
 #include <algorithm>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include <memory>
 #include <limits> // For numeric_limits
 #include <iomanip> // For setw and setfill
 #include <ctime>   // For time functions
 #include <cstdlib>
+#include <cmath>
 #include <ctime>
+#include <cstdio>  // For rename/remove
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <string_view>
+#include <charconv> // For from_chars
+#include <random>
+#include <iterator>
+#include <functional>
+#ifndef _WIN32
+#include <fcntl.h>    // For memory-mapped files
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>   // Also for fsync
+#else
+#include <io.h>       // For _commit
+#endif
 using namespace std;
 
 
+// Hot-path probes. Building with -DDATASTRUCT_PROFILE counts every call of the
+// operations below, times it and records how many nodes or slots it visited, in a
+// histogram with power-of-two buckets. Without the flag ProbeScope is an empty class
+// and every probe compiles away.
+#ifdef DATASTRUCT_PROFILE
+constexpr bool PROFILING = true;
+#else
+constexpr bool PROFILING = false;
+#endif
+
+enum ProbeId {
+    PROBE_QUEUE_ENQUEUE, PROBE_QUEUE_REMOVE, PROBE_REGISTER_SPECTATOR, PROBE_REMOVE_SPECTATOR,
+    PROBE_SEARCH_SPECTATOR, PROBE_HAS_ENTERED, PROBE_HAS_EXITED, PROBE_MOVE_TO_ENTERED, PROBE_MOVE_TO_EXITED,
+    PROBE_ADD_WINNER, PROBE_REPLACE_PLAYER, PROBE_SET_PLAYER_ABSENT, PROBE_FIND_OR_CREATE_PLAYER, PROBE_COUNT
+};
+
+const char* const PROBE_NAMES[PROBE_COUNT] = {
+    "PriorityQueue::enqueue", "PriorityQueue::removeSpectator", "SpectatorManager::registerSpectator",
+    "SpectatorManager::removeSpectator", "SpectatorManager::searchSpectator", "SpectatorManager::hasEntered",
+    "SpectatorManager::hasExited", "SpectatorManager::moveToEntered", "SpectatorManager::moveToExited",
+    "WinnerList::addWinner", "TournamentScheduler::replacePlayer", "TournamentScheduler::setPlayerAbsent",
+    "PlayerStatsTable::findOrCreate"};
+
+const int PROBE_BUCKETS = 24; // 0 visits, 1, 2-3, 4-7, ... and the last bucket for everything longer
+
+struct ProbeCounters {
+    atomic<uint64_t> calls;
+    atomic<uint64_t> nanoseconds;
+    atomic<uint64_t> visited;
+    atomic<uint64_t> maxVisited;
+    atomic<uint64_t> buckets[PROBE_BUCKETS];
+};
+
+ProbeCounters probeCounters[PROBE_COUNT]; // Zeroed at startup; updated from any thread
+
+template <bool Enabled>
+class BasicProbeScope;
+
+// Construct one at the start of a probed call and call visit() for every node it
+// looks at; the destructor adds the call to probeCounters
+template <>
+class BasicProbeScope<true> {
+private:
+    ProbeId id;
+    uint64_t visits;
+    chrono::steady_clock::time_point started;
+
+public:
+    explicit BasicProbeScope(ProbeId id) : id(id), visits(0), started(chrono::steady_clock::now()) {}
+
+    BasicProbeScope(const BasicProbeScope&) = delete;
+    BasicProbeScope& operator=(const BasicProbeScope&) = delete;
+
+    void visit(uint64_t nodes = 1) { visits += nodes; }
+
+    ~BasicProbeScope() {
+        ProbeCounters& counters = probeCounters[id];
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count();
+        counters.calls.fetch_add(1, memory_order_relaxed);
+        counters.nanoseconds.fetch_add(static_cast<uint64_t>(elapsed), memory_order_relaxed);
+        counters.visited.fetch_add(visits, memory_order_relaxed);
+        uint64_t longest = counters.maxVisited.load(memory_order_relaxed);
+        while (visits > longest && !counters.maxVisited.compare_exchange_weak(longest, visits, memory_order_relaxed)) {
+        }
+        int bucket = 0;
+        for (uint64_t rest = visits; rest && bucket < PROBE_BUCKETS - 1; rest >>= 1) {
+            bucket++;
+        }
+        counters.buckets[bucket].fetch_add(1, memory_order_relaxed);
+    }
+};
+
+template <>
+class BasicProbeScope<false> {
+public:
+    explicit BasicProbeScope(ProbeId) {}
+    void visit(uint64_t = 1) {}
+};
+
+using ProbeScope = BasicProbeScope<PROFILING>;
+
+// Lowest visit count that falls into a histogram bucket
+uint64_t probeBucketStart(int bucket) {
+    return bucket == 0 ? 0 : uint64_t(1) << (bucket - 1);
+}
+
+// Text table of every probe that has been called, slowest total time first
+void displayProbeStats() {
+    if (!PROFILING) {
+        cout << "\nHot-path probes are not compiled in. Rebuild with -DDATASTRUCT_PROFILE to collect them.\n";
+        return;
+    }
+    vector<int> order;
+    for (int id = 0; id < PROBE_COUNT; id++) {
+        if (probeCounters[id].calls.load()) order.push_back(id);
+    }
+    sort(order.begin(), order.end(), [](int a, int b) {
+        return probeCounters[a].nanoseconds.load() > probeCounters[b].nanoseconds.load();
+    });
+
+    cout << "\n===== HOT-PATH STATISTICS =====\n";
+    if (order.empty()) {
+        cout << "No probed operations have run yet.\n";
+        return;
+    }
+    cout << setw(38) << left << "Operation" << right << setw(11) << "Calls" << setw(12) << "Total ms"
+         << setw(11) << "Avg ns" << setw(13) << "Avg visits" << setw(12) << "Max visits" << "\n";
+    for (int id : order) {
+        const ProbeCounters& counters = probeCounters[id];
+        uint64_t calls = counters.calls.load();
+        cout << setw(38) << left << PROBE_NAMES[id] << right << setw(11) << calls << fixed << setprecision(1)
+             << setw(12) << counters.nanoseconds.load() / 1e6 << setw(11)
+             << static_cast<double>(counters.nanoseconds.load()) / calls << setw(13)
+             << static_cast<double>(counters.visited.load()) / calls << setw(12) << counters.maxVisited.load() << "\n";
+        cout << "    visits:";
+        for (int bucket = 0; bucket < PROBE_BUCKETS; bucket++) {
+            if (uint64_t count = counters.buckets[bucket].load()) {
+                cout << " " << probeBucketStart(bucket) << (bucket == PROBE_BUCKETS - 1 ? "+" : "") << ":" << count;
+            }
+        }
+        cout << "\n";
+    }
+}
+
+// The same statistics as one JSON object, every bucket included
+void writeProbeStatsJson(ostream& out) {
+    out << "{\"profiling\":" << (PROFILING ? "true" : "false") << ",\"probes\":[";
+    bool first = true;
+    for (int id = 0; id < PROBE_COUNT && PROFILING; id++) {
+        const ProbeCounters& counters = probeCounters[id];
+        out << (first ? "" : ",") << "{\"name\":\"" << PROBE_NAMES[id] << "\",\"calls\":" << counters.calls.load()
+            << ",\"nanoseconds\":" << counters.nanoseconds.load() << ",\"visited\":" << counters.visited.load()
+            << ",\"max_visited\":" << counters.maxVisited.load() << ",\"histogram\":[";
+        for (int bucket = 0; bucket < PROBE_BUCKETS; bucket++) {
+            out << (bucket ? "," : "") << "{\"from\":" << probeBucketStart(bucket) << ",\"calls\":"
+                << counters.buckets[bucket].load() << "}";
+        }
+        out << "]}";
+        first = false;
+    }
+    out << "]}\n";
+}
+
+const string PROFILE_FILENAME = "profile_stats.json";
+
+// Show the statistics and also write them to PROFILE_FILENAME as JSON
+void reportProbeStats() {
+    displayProbeStats();
+    if (!PROFILING) return;
+    ofstream file(PROFILE_FILENAME);
+    writeProbeStatsJson(file);
+    if (file) {
+        cout << "Statistics written to " << PROFILE_FILENAME << ".\n";
+    } else {
+        cout << "Error writing " << PROFILE_FILENAME << "!\n";
+    }
+}
+
+void resetProbeStats() {
+    for (ProbeCounters& counters : probeCounters) {
+        counters.calls = 0;
+        counters.nanoseconds = 0;
+        counters.visited = 0;
+        counters.maxVisited = 0;
+        for (atomic<uint64_t>& bucket : counters.buckets) {
+            bucket = 0;
+        }
+    }
+}
+
+
+// Read-only memory mapping of a whole file. On Windows, where there is no mmap,
+// the file is read into memory instead.
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+#ifdef _WIN32
+    vector<char> buffer;
+#endif
+
+public:
+    MappedFile() : bytes(nullptr), length(0) {}
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file does not exist or is shorter than minSize bytes
+    bool open(const string& filename, size_t minSize) {
+        close();
+#ifdef _WIN32
+        ifstream file(filename, ios::binary);
+        if (!file) return false;
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        if (buffer.size() < minSize) {
+            close();
+            return false;
+        }
+        bytes = buffer.data();
+        length = buffer.size();
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(minSize) || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        bytes = static_cast<const char*>(mapped);
+        length = info.st_size;
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        buffer.clear();
+        buffer.shrink_to_fit();
+#else
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+// True if length bytes starting at offset lie inside a file of fileSize bytes
+inline bool fitsInFile(uint64_t offset, uint64_t length, uint64_t fileSize) {
+    return offset <= fileSize && length <= fileSize - offset;
+}
+
+// Whole-application snapshot (app_snapshot.bin). Every subsystem writes its state
+// into its own section as a flat run of 32-bit words; strings are stored once in a
+// shared pool and referenced by offset and length. Loading maps the file and walks
+// each section once, rebuilding the linked lists with their pointers fixed up, so
+// nothing has to be parsed as text.
+//
+//   SnapshotHeader
+//   section words (uint32) for every section in SnapshotSection order
+//   string pool
+enum SnapshotSection {
+    SNAP_SPECTATORS, SNAP_ENTRANCE_QUEUE, SNAP_EXIT_QUEUE, SNAP_SCHEDULE,
+    SNAP_WINNERS, SNAP_KNOCKOUT_PLAYERS, SNAP_WITHDRAWALS, SNAP_SECTION_COUNT
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t sectionOffset[SNAP_SECTION_COUNT];
+    uint64_t sectionWords[SNAP_SECTION_COUNT];
+    uint64_t stringPoolOffset;
+    uint64_t stringPoolSize;
+    uint64_t fileSize;
+};
+
+const char SNAPSHOT_MAGIC[8] = {'A', 'P', 'U', 'S', 'N', 'A', 'P', 'S'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+class SnapshotWriter {
+private:
+    vector<uint32_t> sections[SNAP_SECTION_COUNT];
+    string strings;
+    int current;
+
+public:
+    SnapshotWriter() : current(0) {}
+
+    void beginSection(SnapshotSection section) { current = section; }
+
+    void putInt(int value) { sections[current].push_back(static_cast<uint32_t>(value)); }
+
+    void putBool(bool value) { sections[current].push_back(value ? 1 : 0); }
+
+    void putString(const string& value) {
+        sections[current].push_back(static_cast<uint32_t>(strings.size()));
+        sections[current].push_back(static_cast<uint32_t>(value.size()));
+        strings += value;
+    }
+
+    // Write to a temp file, force it to disk, then rename it over filename
+    bool save(const string& filename) {
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+        header.version = SNAPSHOT_VERSION;
+        header.sectionCount = SNAP_SECTION_COUNT;
+        uint64_t offset = sizeof(SnapshotHeader);
+        for (int section = 0; section < SNAP_SECTION_COUNT; section++) {
+            header.sectionOffset[section] = offset;
+            header.sectionWords[section] = sections[section].size();
+            offset += sections[section].size() * sizeof(uint32_t);
+        }
+        header.stringPoolOffset = offset;
+        header.stringPoolSize = strings.size();
+        header.fileSize = offset + strings.size();
+
+        string tempName = filename + ".tmp";
+        FILE* file = fopen(tempName.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        for (const auto& words : sections) {
+            ok = ok && fwrite(words.data(), sizeof(uint32_t), words.size(), file) == words.size();
+        }
+        ok = ok && fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+        ok = ok && fflush(file) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(file)) == 0;
+#else
+        ok = ok && fsync(fileno(file)) == 0;
+#endif
+        ok = (fclose(file) == 0) && ok;
+        if (!ok) {
+            remove(tempName.c_str());
+            return false;
+        }
+#ifdef _WIN32
+        remove(filename.c_str()); // rename() does not overwrite on Windows
+#endif
+        return rename(tempName.c_str(), filename.c_str()) == 0;
+    }
+};
+
+class SnapshotReader {
+private:
+    MappedFile file;
+    const SnapshotHeader* header;
+
+public:
+    // Reads one section front to back. Reading past its end yields zeros and
+    // empty strings and clears good().
+    class Cursor {
+    private:
+        const uint32_t* at;
+        const uint32_t* end;
+        const char* pool;
+        uint64_t poolSize;
+        bool ok;
+
+    public:
+        Cursor(const uint32_t* first, const uint32_t* last, const char* strings, uint64_t stringsSize)
+            : at(first), end(last), pool(strings), poolSize(stringsSize), ok(first != nullptr) {}
+
+        int getInt() {
+            if (at >= end) {
+                ok = false;
+                return 0;
+            }
+            return static_cast<int>(*at++);
+        }
+
+        bool getBool() { return getInt() != 0; }
+
+        string getString() {
+            uint32_t offset = static_cast<uint32_t>(getInt());
+            uint32_t length = static_cast<uint32_t>(getInt());
+            if (!ok || static_cast<uint64_t>(offset) + length > poolSize) {
+                ok = false;
+                return string();
+            }
+            return string(pool + offset, length);
+        }
+
+        // A count read from the file, checked against the words left in the section
+        int getCount(int wordsPerItem) {
+            int count = getInt();
+            if (count < 0 || static_cast<uint64_t>(count) * wordsPerItem > static_cast<uint64_t>(end - at)) {
+                ok = false;
+                return 0;
+            }
+            return count;
+        }
+
+        bool good() const { return ok; }
+    };
+
+    SnapshotReader() : header(nullptr) {}
+
+    // Returns false if the file does not exist or is not a valid snapshot
+    bool open(const string& filename) {
+        header = nullptr;
+        if (!file.open(filename, sizeof(SnapshotHeader))) {
+            return false;
+        }
+        const SnapshotHeader* candidate = reinterpret_cast<const SnapshotHeader*>(file.data());
+        if (memcmp(candidate->magic, SNAPSHOT_MAGIC, 8) != 0 || candidate->version != SNAPSHOT_VERSION ||
+            candidate->sectionCount != SNAP_SECTION_COUNT || candidate->fileSize != file.size() ||
+            !sectionsFit(candidate)) {
+            file.close();
+            return false;
+        }
+        header = candidate;
+        return true;
+    }
+
+    Cursor section(SnapshotSection section) const {
+        const uint32_t* first = reinterpret_cast<const uint32_t*>(file.data() + header->sectionOffset[section]);
+        return Cursor(first, first + header->sectionWords[section],
+                      file.data() + header->stringPoolOffset, header->stringPoolSize);
+    }
+
+private:
+    // Every section and the string pool must lie inside the mapped file
+    bool sectionsFit(const SnapshotHeader* candidate) const {
+        for (int s = 0; s < SNAP_SECTION_COUNT; s++) {
+            if (candidate->sectionOffset[s] % sizeof(uint32_t) != 0 ||
+                candidate->sectionWords[s] > file.size() / sizeof(uint32_t) ||
+                !fitsInFile(candidate->sectionOffset[s], candidate->sectionWords[s] * sizeof(uint32_t), file.size())) {
+                return false;
+            }
+        }
+        return fitsInFile(candidate->stringPoolOffset, candidate->stringPoolSize, file.size());
+    }
+};
+
+// Periodic checkpoint of the whole application. main() sets periodicSnapshotSave,
+// and every menu calls saveSnapshotIfDue() before it is shown again, so the
+// snapshot is rewritten once APP_SNAPSHOT_INTERVAL has passed since the last save.
+const chrono::minutes APP_SNAPSHOT_INTERVAL(5);
+function<void()> periodicSnapshotSave;
+chrono::steady_clock::time_point lastSnapshotSave = chrono::steady_clock::now();
+
+void saveSnapshotIfDue() {
+    if (periodicSnapshotSave && chrono::steady_clock::now() - lastSnapshotSave >= APP_SNAPSHOT_INTERVAL) {
+        periodicSnapshotSave();
+    }
+}
+
+
+// Fixed-size blocks for one node type, handed out by IntrusiveNode's operator new.
+// A freed node goes on the free list of the thread that frees it and is reused by
+// that thread's next allocation. When a thread exits, its free blocks and the rest
+// of its current chunk go on a shared free list that other threads take from before
+// they allocate a new chunk. Chunks are never given back, so every block stays
+// reachable from the chunk list until the program exits.
+template <typename T>
+class NodePool {
+private:
+    static const size_t NODES_PER_CHUNK = 256;
+
+    union Slot {
+        Slot* nextFree;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct ThreadCache {
+        Slot* freeList = nullptr;
+        Slot* chunk = nullptr;          // Blocks are handed out from here, front to back
+        size_t used = NODES_PER_CHUNK;  // Blocks of chunk already handed out
+
+        // Give every block this thread still holds back to the shared free list
+        ~ThreadCache() {
+            for (; chunk && used < NODES_PER_CHUNK; used++) {
+                chunk[used].nextFree = freeList;
+                freeList = &chunk[used];
+            }
+            if (freeList) {
+                lock_guard<mutex> lock(chunksMutex());
+                Slot* tail = freeList;
+                while (tail->nextFree) tail = tail->nextFree;
+                tail->nextFree = sharedFreeList();
+                sharedFreeList() = freeList;
+                freeList = nullptr;
+            }
+        }
+    };
+
+    static mutex& chunksMutex() {
+        static mutex chunksLock;
+        return chunksLock;
+    }
+
+    static vector<Slot*>& chunks() {
+        static vector<Slot*> allChunks;
+        return allChunks;
+    }
+
+    // Blocks left behind by threads that have exited; guarded by chunksMutex
+    static Slot*& sharedFreeList() {
+        static Slot* sharedFree = nullptr;
+        return sharedFree;
+    }
+
+    static ThreadCache& cache() {
+        thread_local ThreadCache threadCache;
+        return threadCache;
+    }
+
+public:
+    static void* allocate(size_t size) {
+        if (size != sizeof(T)) {
+            return ::operator new(size); // A type derived from T
+        }
+        ThreadCache& local = cache();
+        if (Slot* slot = local.freeList) {
+            local.freeList = slot->nextFree;
+            return slot;
+        }
+        if (local.used == NODES_PER_CHUNK) {
+            lock_guard<mutex> lock(chunksMutex());
+            if (Slot* slot = sharedFreeList()) {
+                // Take over everything exited threads left behind
+                local.freeList = slot->nextFree;
+                sharedFreeList() = nullptr;
+                return slot;
+            }
+            local.chunk = static_cast<Slot*>(::operator new(sizeof(Slot) * NODES_PER_CHUNK));
+            local.used = 0;
+            chunks().push_back(local.chunk);
+        }
+        return &local.chunk[local.used++];
+    }
+
+    static void release(void* memory, size_t size) {
+        if (!memory) return;
+        if (size != sizeof(T)) {
+            ::operator delete(memory);
+            return;
+        }
+        Slot* slot = static_cast<Slot*>(memory);
+        ThreadCache& local = cache();
+        slot->nextFree = local.freeList;
+        local.freeList = slot;
+    }
+};
+
+// Base of every node kept in an IntrusiveList: the link to the next node, and
+// allocation from the node type's pool
+template <typename T>
+struct IntrusiveNode {
+    T* next = nullptr;
+
+    static void* operator new(size_t size) { return NodePool<T>::allocate(size); }
+    static void operator delete(void* memory, size_t size) { NodePool<T>::release(memory, size); }
+};
+
+// Singly linked list of nodes that carry their own next pointer. It keeps the head,
+// the tail and the size, so pushFront, pushBack, popFront, insertAfter, removeAfter
+// and splice are all O(1). The list owns its nodes: clear() and the destructor delete
+// them, and a node must be unlinked before it is put on another list.
+template <typename T>
+class IntrusiveList {
+private:
+    T* first;
+    T* last;
+    size_t count;
+
+public:
+    class iterator {
+    private:
+        T* node;
+
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        explicit iterator(T* node = nullptr) : node(node) {}
+        T& operator*() const { return *node; }
+        T* operator->() const { return node; }
+        iterator& operator++() {
+            node = node->next;
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return node == other.node; }
+        bool operator!=(const iterator& other) const { return node != other.node; }
+    };
+
+    IntrusiveList() : first(nullptr), last(nullptr), count(0) {}
+
+    ~IntrusiveList() {
+        clear();
+    }
+
+    IntrusiveList(const IntrusiveList&) = delete;
+    IntrusiveList& operator=(const IntrusiveList&) = delete;
+
+    IntrusiveList(IntrusiveList&& other) noexcept : first(other.first), last(other.last), count(other.count) {
+        other.first = other.last = nullptr;
+        other.count = 0;
+    }
+
+    IntrusiveList& operator=(IntrusiveList&& other) noexcept {
+        if (this != &other) {
+            clear();
+            splice(other);
+        }
+        return *this;
+    }
+
+    bool empty() const { return first == nullptr; }
+    size_t size() const { return count; }
+    T* front() const { return first; }
+    T* back() const { return last; }
+    iterator begin() const { return iterator(first); }
+    iterator end() const { return iterator(); }
+
+    void pushFront(T* node) {
+        node->next = first;
+        first = node;
+        if (!last) last = node;
+        count++;
+    }
+
+    void pushBack(T* node) {
+        node->next = nullptr;
+        if (last) {
+            last->next = node;
+        } else {
+            first = node;
+        }
+        last = node;
+        count++;
+    }
+
+    // Link node in right after position, or at the front if position is null
+    void insertAfter(T* position, T* node) {
+        if (!position) {
+            pushFront(node);
+            return;
+        }
+        node->next = position->next;
+        position->next = node;
+        if (last == position) last = node;
+        count++;
+    }
+
+    // Unlink the node after position (the front if position is null) and return it,
+    // or null if there is none. The caller owns the returned node.
+    T* removeAfter(T* position) {
+        T* node = position ? position->next : first;
+        if (!node) return nullptr;
+        if (position) {
+            position->next = node->next;
+        } else {
+            first = node->next;
+        }
+        if (last == node) last = position;
+        node->next = nullptr;
+        count--;
+        return node;
+    }
+
+    T* popFront() {
+        return removeAfter(nullptr);
+    }
+
+    // Move every node of other to the end of this list
+    void splice(IntrusiveList& other) {
+        if (other.empty()) return;
+        if (last) {
+            last->next = other.first;
+        } else {
+            first = other.first;
+        }
+        last = other.last;
+        count += other.count;
+        other.first = other.last = nullptr;
+        other.count = 0;
+    }
+
+    // Delete every node for which shouldRemove(node) is true, keeping the others in order
+    template <typename Predicate>
+    size_t removeIf(Predicate shouldRemove) {
+        size_t removed = 0;
+        T* previous = nullptr;
+        T* node = first;
+        while (node) {
+            T* following = node->next;
+            if (shouldRemove(static_cast<const T&>(*node))) {
+                delete removeAfter(previous);
+                removed++;
+            } else {
+                previous = node;
+            }
+            node = following;
+        }
+        return removed;
+    }
+
+    void clear() {
+        while (T* node = popFront()) {
+            delete node;
+        }
+    }
+};
+
 
 // ==================== Ticket Sales & Spectator Management (LOW TENG FONG TP073919 ) ====================
 
-struct Spectator {
+struct Spectator : IntrusiveNode<Spectator> {
     int id;
     string name;
     int priority; // 0 = VIP, 1 = Early-bird, 2 = Normal
     string registrationTime; // Time of registration
-    Spectator* next;
 
-    Spectator(int i, string n, int p, string t) : id(i), name(n), priority(p), registrationTime(t), next(nullptr) {}
+    Spectator(int i, string n, int p, string t) : id(i), name(n), priority(p), registrationTime(t) {}
 };
 
+// Write a list of spectators to the current snapshot section
+void saveSpectatorList(SnapshotWriter& out, const IntrusiveList<Spectator>& spectators) {
+    out.putInt(static_cast<int>(spectators.size()));
+    for (const Spectator& spectator : spectators) {
+        out.putInt(spectator.id);
+        out.putString(spectator.name);
+        out.putInt(spectator.priority);
+        out.putString(spectator.registrationTime);
+    }
+}
+
+// Append the spectators written by saveSpectatorList to spectators, in the same order
+void loadSpectatorList(SnapshotReader::Cursor& in, IntrusiveList<Spectator>& spectators) {
+    int count = in.getCount(6);
+    for (int i = 0; i < count; i++) {
+        int id = in.getInt();
+        string name = in.getString();
+        int priority = in.getInt();
+        spectators.pushBack(new Spectator(id, name, priority, in.getString()));
+    }
+}
+
 // Priority Queue class for spectators
 class PriorityQueue {
 private:
-    Spectator* head;
+    static const int PRIORITY_LEVELS = 3;
+    IntrusiveList<Spectator> queue;
+    Spectator* lastOfPriority[PRIORITY_LEVELS]; // Last queued spectator of each priority, or null
+
+    static int level(int priority) {
+        return min(max(priority, 0), PRIORITY_LEVELS - 1);
+    }
+
+    // Keep lastOfPriority right after spectator, which followed previous, was unlinked
+    void forget(Spectator* spectator, Spectator* previous) {
+        int p = level(spectator->priority);
+        if (lastOfPriority[p] == spectator) {
+            lastOfPriority[p] = (previous && level(previous->priority) == p) ? previous : nullptr;
+        }
+    }
 
 public:
-    PriorityQueue() : head(nullptr) {}
+    PriorityQueue() : lastOfPriority() {}
 
-    // Add a spectator to the priority queue based on priority
+    // Add a spectator behind everyone of the same or a higher priority. The insertion
+    // point is the last spectator of that priority, or of the next higher one.
     void enqueue(Spectator* newSpectator) {
-        if (!head || newSpectator->priority < head->priority) {
-            newSpectator->next = head;
-            head = newSpectator;
-        } else {
-            Spectator* temp = head;
-            while (temp->next && temp->next->priority <= newSpectator->priority) {
-                temp = temp->next;
-            }
-            newSpectator->next = temp->next;
-            temp->next = newSpectator;
+        ProbeScope probe(PROBE_QUEUE_ENQUEUE);
+        int p = level(newSpectator->priority);
+        Spectator* position = nullptr; // Front of the queue if nobody goes first
+        for (int q = p; q >= 0 && !position; q--) {
+            position = lastOfPriority[q];
+            probe.visit();
         }
+        queue.insertAfter(position, newSpectator);
+        lastOfPriority[p] = newSpectator;
     }
 
     // Dequeue a spectator from the priority queue
     Spectator* dequeue() {
-        if (!head) {
-            return nullptr;
+        Spectator* spectator = queue.popFront();
+        if (spectator) {
+            forget(spectator, nullptr);
         }
-        Spectator* temp = head;
-        head = head->next;
-        return temp;
+        return spectator;
     }
 
     // Check if the queue is empty
     bool isEmpty() {
-        return head == nullptr;
+        return queue.empty();
     }
 
     // Clear the queue
     void clear() {
-        while (!isEmpty()) {
-            Spectator* temp = head;
-            head = head->next;
-            delete temp;
-        }
+        queue.clear();
+        fill(lastOfPriority, lastOfPriority + PRIORITY_LEVELS, nullptr);
     }
 
     // Display the current priority queue
     void displayQueue(const string& queueType) {
-        if (!head) {
+        if (queue.empty()) {
             cout << "\nCurrent " << queueType << " Queueing Situation:\n";
             cout << "No spectators in the queue.\n";
             return;
@@ -83,38 +841,41 @@ public:
 
         cout << "\nScanning now...\n";
         cout << "\n=====" << queueType << " Queueing Situation=====\n";
-        Spectator* temp = head;
-        while (temp) {
-            string priorityStr = (temp->priority == 0) ? "VIP" : (temp->priority == 1) ? "Early-bird" : "Normal";
-            cout << temp->name << " (" << priorityStr << ") queuing...\n";
-            temp = temp->next;
+        for (const Spectator& spectator : queue) {
+            string priorityStr = (spectator.priority == 0) ? "VIP" : (spectator.priority == 1) ? "Early-bird" : "Normal";
+            cout << spectator.name << " (" << priorityStr << ") queuing...\n";
         }
     }
 
     // Get the head of the queue
     Spectator* getHead() {
-        return head;
+        return queue.front();
+    }
+
+    void saveSnapshot(SnapshotWriter& out) {
+        saveSpectatorList(out, queue);
+    }
+
+    // Replace the queue with the one stored in the snapshot (already in priority order)
+    void loadSnapshot(SnapshotReader::Cursor& in) {
+        clear();
+        loadSpectatorList(in, queue);
+        for (Spectator& spectator : queue) {
+            lastOfPriority[level(spectator.priority)] = &spectator;
+        }
     }
 
     // Generate a random ID from the valid range of spectators in the queue
     int getRandomID() {
-        if (!head) {
+        if (queue.empty()) {
             return -1; // No spectators in the queue
         }
 
-        // Count the number of spectators in the queue
-        int count = 0;
-        Spectator* temp = head;
-        while (temp) {
-            count++;
-            temp = temp->next;
-        }
-
         // Generate a random index
-        int randomIndex = rand() % count;
+        int randomIndex = rand() % static_cast<int>(queue.size());
 
         // Traverse to the random index
-        temp = head;
+        Spectator* temp = queue.front();
         for (int i = 0; i < randomIndex; i++) {
             temp = temp->next;
         }
@@ -124,60 +885,35 @@ public:
 
     // Remove a spectator by ID from the queue and return the removed spectator
     Spectator* removeSpectator(int id) {
-        if (!head) {
-            return nullptr;
-        }
-
-        // If the spectator to remove is at the head
-        if (head->id == id) {
-            Spectator* temp = head;
-            head = head->next;
-            temp->next = nullptr; // Disconnect the spectator from the queue
-            return temp;
-        }
-
-        // Traverse the queue to find the spectator
-        Spectator* temp = head;
-        while (temp->next && temp->next->id != id) {
-            temp = temp->next;
-        }
-
-        // If the spectator is found, remove them
-        if (temp->next && temp->next->id == id) {
-            Spectator* toRemove = temp->next;
-            temp->next = toRemove->next;
-            toRemove->next = nullptr; // Disconnect the spectator from the queue
-            return toRemove;
+        ProbeScope probe(PROBE_QUEUE_REMOVE);
+        Spectator* previous = nullptr;
+        for (Spectator* temp = queue.front(); temp; previous = temp, temp = temp->next) {
+            if (temp->id == id) {
+                queue.removeAfter(previous); // Disconnect the spectator from the queue
+                forget(temp, previous);
+                return temp;
+            }
+            probe.visit();
         }
-
         return nullptr; // Spectator not found
     }
 };
 
 class SpectatorManager {
 private:
-    Spectator* head; // Linked list to store all registered spectators
-    Spectator* enteredSpectators; // Linked list to store spectators who have entered
-    Spectator* exitedSpectators; // Linked list to store spectators who have exited
+    IntrusiveList<Spectator> spectators; // Linked list to store all registered spectators
+    IntrusiveList<Spectator> enteredSpectators; // Linked list to store spectators who have entered
+    IntrusiveList<Spectator> exitedSpectators; // Linked list to store spectators who have exited
     int idCounter;
     int earlyBirdCount; // Track the number of Early-bird registrations
 
 public:
-    SpectatorManager() : head(nullptr), enteredSpectators(nullptr), exitedSpectators(nullptr), idCounter(1), earlyBirdCount(0) {}
+    SpectatorManager() : idCounter(1), earlyBirdCount(0) {}
 
     // Add a spectator to the linked list (not a queue)
     void registerSpectator(string name, int priority, string registrationTime) {
-        Spectator* newSpectator = new Spectator(idCounter++, name, priority, registrationTime);
-
-        if (!head) {
-            head = newSpectator;
-        } else {
-            Spectator* temp = head;
-            while (temp->next) {
-                temp = temp->next;
-            }
-            temp->next = newSpectator;
-        }
+        ProbeScope probe(PROBE_REGISTER_SPECTATOR);
+        spectators.pushBack(new Spectator(idCounter++, name, priority, registrationTime));
 
         // Increment Early-bird count if priority is Early-bird
         if (priority == 1) {
@@ -197,46 +933,49 @@ public:
 
     // Move a spectator to the entered list
     void moveToEntered(Spectator* spectator) {
-        if (!enteredSpectators) {
-            enteredSpectators = spectator;
-        } else {
-            Spectator* temp = enteredSpectators;
-            while (temp->next) {
-                temp = temp->next;
-            }
-            temp->next = spectator;
-        }
-        spectator->next = nullptr; // Ensure the spectator is not part of any other list
+        ProbeScope probe(PROBE_MOVE_TO_ENTERED);
+        enteredSpectators.pushBack(spectator); // The spectator must not be part of any other list
     }
 
     // Move a spectator to the exited list
     void moveToExited(Spectator* spectator) {
-        if (!exitedSpectators) {
-            exitedSpectators = spectator;
-        } else {
-            Spectator* temp = exitedSpectators;
-            while (temp->next) {
-                temp = temp->next;
-            }
-            temp->next = spectator;
-        }
-        spectator->next = nullptr; // Ensure the spectator is not part of any other list
+        ProbeScope probe(PROBE_MOVE_TO_EXITED);
+        exitedSpectators.pushBack(spectator); // The spectator must not be part of any other list
     }
 
     // Get the head of the main list
     Spectator* getHead() {
-        return head;
+        return spectators.front();
     }
 
     // Get the head of the entered spectators list
     Spectator* getEnteredHead() {
-        return enteredSpectators;
+        return enteredSpectators.front();
+    }
+
+    void saveSnapshot(SnapshotWriter& out) {
+        out.putInt(idCounter);
+        out.putInt(earlyBirdCount);
+        saveSpectatorList(out, spectators);
+        saveSpectatorList(out, enteredSpectators);
+        saveSpectatorList(out, exitedSpectators);
+    }
+
+    // Restore the state of a manager that has no spectators yet
+    void loadSnapshot(SnapshotReader::Cursor& in) {
+        idCounter = in.getInt();
+        earlyBirdCount = in.getInt();
+        loadSpectatorList(in, spectators);
+        loadSpectatorList(in, enteredSpectators);
+        loadSpectatorList(in, exitedSpectators);
     }
 
     // Check if a spectator has entered
     bool hasEntered(int id) {
-        Spectator* temp = enteredSpectators;
+        ProbeScope probe(PROBE_HAS_ENTERED);
+        Spectator* temp = enteredSpectators.front();
         while (temp) {
+            probe.visit();
             if (temp->id == id) {
                 return true;
             }
@@ -247,8 +986,10 @@ public:
 
     // Check if a spectator has exited
     bool hasExited(int id) {
-        Spectator* temp = exitedSpectators;
+        ProbeScope probe(PROBE_HAS_EXITED);
+        Spectator* temp = exitedSpectators.front();
         while (temp) {
+            probe.visit();
             if (temp->id == id) {
                 return true;
             }
@@ -259,29 +1000,25 @@ public:
 
     // Remove a spectator from the main list
     void removeSpectator(Spectator* spectator) {
-        if (!head) return;
-
-        if (head == spectator) {
-            head = head->next;
-        } else {
-            Spectator* temp = head;
-            while (temp->next && temp->next != spectator) {
-                temp = temp->next;
-            }
-            if (temp->next == spectator) {
-                temp->next = spectator->next;
+        ProbeScope probe(PROBE_REMOVE_SPECTATOR);
+        Spectator* previous = nullptr;
+        for (Spectator* temp = spectators.front(); temp; previous = temp, temp = temp->next) {
+            if (temp == spectator) {
+                spectators.removeAfter(previous);
+                return;
             }
+            probe.visit();
         }
     }
 
     // Display all spectators in the linked list
     void displayAll() {
-        if (!head) {
+        if (spectators.empty()) {
             cout << "No spectators in the list.\n";
             return;
         }
 
-        Spectator* temp = head;
+        Spectator* temp = spectators.front();
         while (temp) {
             string priorityStr = (temp->priority == 0) ? "VIP" : (temp->priority == 1) ? "Early-bird" : "Normal";
             cout << "Spectator ID: " << temp->id << ", Name: " << temp->name << ", Priority: " << priorityStr
@@ -292,18 +1029,20 @@ public:
 
     // Search for a spectator by ID or name
     void searchSpectator(int id = -1, string name = "") {
-        if (!head) {
+        if (spectators.empty()) {
             cout << "No spectators in the list.\n";
             return;
         }
 
-        Spectator* temp = head;
+        ProbeScope probe(PROBE_SEARCH_SPECTATOR);
+        Spectator* temp = spectators.front();
         bool anyFound = false; // Track if any match is found
 
         // Convert the search query to lowercase
         transform(name.begin(), name.end(), name.begin(), ::tolower);
 
         while (temp) {
+            probe.visit();
             bool found = false; // Track if the current spectator is a match
 
             if (id != -1) {
@@ -344,75 +1083,87 @@ public:
 
 //Schedule Management
 // Match structure
-struct Match
+struct Match : IntrusiveNode<Match>
 {
     string player1;
     string player2;
     string stage;
     bool attend1;
     bool attend2;
-    Match *next;
 
-    Match(string p1, string p2, string stg) : player1(p1), player2(p2), stage(stg), attend1(true), attend2(true), next(nullptr) {}
+    Match(string p1, string p2, string stg) : player1(p1), player2(p2), stage(stg), attend1(true), attend2(true) {}
+};
+
+// One schedule change from a processed withdrawal: the active player is either
+// replaced by substitute or, when substitute is empty, marked absent
+struct ScheduleChange
+{
+    string player;
+    string substitute;
+
+    ScheduleChange(string p, string sub) : player(p), substitute(sub) {}
 };
 
 // WinnerNode structure
-struct WinnerNode
+struct WinnerNode : IntrusiveNode<WinnerNode>
 {
     string winner;
-    WinnerNode *next;
 
-    WinnerNode(string w) : winner(w), next(nullptr) {}
+    WinnerNode(string w) : winner(w) {}
 };
 
 // WinnerList class
 class WinnerList
 {
 private:
-    WinnerNode *head;
+    IntrusiveList<WinnerNode> winners;
 
 public:
-    WinnerList() : head(nullptr) {}
-
     // Add a winner to the list
     void addWinner(string winner)
     {
-        WinnerNode *newWinner = new WinnerNode(winner);
-        if (!head)
-        {
-            head = newWinner;
-        }
-        else
-        {
-            WinnerNode *temp = head;
-            while (temp->next)
-            {
-                temp = temp->next;
-            }
-            temp->next = newWinner;
-        }
-    }
-
-    // Display all winners
-    void display()
-    {
-        if (!head)
+        ProbeScope probe(PROBE_ADD_WINNER);
+        winners.pushBack(new WinnerNode(winner));
+    }
+
+    // Display all winners
+    void display()
+    {
+        if (winners.empty())
         {
             cout << "No winners yet." << endl;
             return;
         }
-        WinnerNode *temp = head;
-        while (temp)
+        for (const WinnerNode &node : winners)
         {
-            cout << temp->winner << endl;
-            temp = temp->next;
+            cout << node.winner << endl;
         }
     }
 
     // Get the head of the list (for scheduling next stage)
     WinnerNode *getHead()
     {
-        return head;
+        return winners.front();
+    }
+
+    int size()
+    {
+        return static_cast<int>(winners.size());
+    }
+
+    void saveSnapshot(SnapshotWriter &out)
+    {
+        out.putInt(size());
+        for (const WinnerNode &node : winners)
+            out.putString(node.winner);
+    }
+
+    // Restore the winners of an empty list, in their saved order
+    void loadSnapshot(SnapshotReader::Cursor &in)
+    {
+        int count = in.getCount(2);
+        for (int i = 0; i < count; i++)
+            winners.pushBack(new WinnerNode(in.getString()));
     }
 };
 
@@ -420,16 +1171,13 @@ public:
 class TournamentScheduler
 {
 private:
-    Match *front;
-    Match *rear;
+    IntrusiveList<Match> matches; // Played in order, front first
 
 public:
-    TournamentScheduler() : front(nullptr), rear(nullptr) {}
-
     // Check if the queue is empty
     bool is_empty()
     {
-        return front == nullptr;
+        return matches.empty();
     }
 
     // Add a match to the queue
@@ -441,20 +1189,8 @@ public:
             return;
         }
 
-        Match *newMatch = new Match(p1, p2, stage);
         cout << "Adding match: " << p1 << " vs " << p2 << " at stage: " << stage << endl;
-
-        if (is_empty())
-        {
-            front = rear = newMatch;
-            rear->next = front; // Make it circular
-        }
-        else
-        {
-            rear->next = newMatch;
-            rear = newMatch;
-            rear->next = front; // Maintain circularity
-        }
+        matches.pushBack(new Match(p1, p2, stage));
     }
 
     // Display all matches in the queue
@@ -466,49 +1202,65 @@ public:
             return;
         }
 
-        Match *temp = front;
-        do
+        for (const Match &match : matches)
         {
-            cout << "Match: " << temp->player1 << " vs " << temp->player2 << " (Stage: " << temp->stage << ")" << endl;
-            temp = temp->next;
-        } while (temp != front);
+            cout << "Match: " << match.player1 << " vs " << match.player2 << " (Stage: " << match.stage << ")" << endl;
+        }
     }
 
     // Clear the queue
     void clearQueue()
     {
-        if (is_empty())
-            return;
-
-        Match *temp = front;
-        do
-        {
-            Match *nextMatch = temp->next;
-            delete temp;
-            temp = nextMatch;
-        } while (temp != front);
-
-        front = rear = nullptr;
+        matches.clear();
     }
 
     // Get the front of the queue (for processing matches)
     Match *getFront()
     {
-        return front;
+        return matches.front();
+    }
+
+    void saveSnapshot(SnapshotWriter &out)
+    {
+        out.putInt(static_cast<int>(matches.size()));
+        for (const Match &match : matches)
+        {
+            out.putString(match.player1);
+            out.putString(match.player2);
+            out.putString(match.stage);
+            out.putBool(match.attend1);
+            out.putBool(match.attend2);
+        }
+    }
+
+    // Restore the saved matches into an empty queue
+    void loadSnapshot(SnapshotReader::Cursor &in)
+    {
+        int count = in.getCount(8);
+        for (int i = 0; i < count; i++)
+        {
+            string p1 = in.getString();
+            string p2 = in.getString();
+            Match *match = new Match(p1, p2, in.getString());
+            match->attend1 = in.getBool();
+            match->attend2 = in.getBool();
+            matches.pushBack(match);
+        }
     }
 
     //for task three
 
     void replacePlayer(const string& originalPlayer, const string& substitutePlayer) {
+        ProbeScope probe(PROBE_REPLACE_PLAYER);
         if (is_empty()) {
             cout << "No matches scheduled.\n";
             return;
         }
 
-        Match* temp = front;
         bool found = false;
 
-        do {
+        for (Match* temp = matches.front(); temp; temp = temp->next) {
+            probe.visit();
             bool replaced = false; // Track if replacement happened in this match
 
             if (temp->player1 == originalPlayer) {
@@ -525,9 +1277,7 @@ public:
                 cout << "Player " << originalPlayer << " replaced by " << substitutePlayer
                      << " in match (" << temp->player1 << " vs " << temp->player2 << ").\n";
             }
-
-            temp = temp->next;
-        } while (temp != front);
+        }
 
         if (!found) {
             cout << "Player " << originalPlayer << " not found in any scheduled matches.\n";
@@ -535,15 +1285,16 @@ public:
     }
 
     void setPlayerAbsent(const string& playerName) {
+        ProbeScope probe(PROBE_SET_PLAYER_ABSENT);
         if (is_empty()) {
             cout << "No matches scheduled.\n";
             return;
         }
 
-        Match* temp = front;
         bool found = false;
 
-        do {
+        for (Match* temp = matches.front(); temp; temp = temp->next) {
+            probe.visit();
             if (temp->player1 == playerName) {
                 temp->attend1 = false;
                 found = true;
@@ -559,15 +1310,83 @@ public:
 
 //            cout << "DEBUG: Match: " << temp->player1 << " (attend1=" << temp->attend1
 //             << ") vs " << temp->player2 << " (attend2=" << temp->attend2 << ")" << endl;
-
-            temp = temp->next;
-        } while (temp != front);
+        }
 
         if (!found) {
             cout << "Player " << playerName << " not found in any scheduled matches.\n";
         }
     }
 
+    // Apply a whole batch of withdrawals in a single pass over the schedule.
+    // changes are in arrival order; each slot replays only the changes aimed at
+    // the name it held at that point, so the result is the same as calling
+    // replacePlayer / setPlayerAbsent once per withdrawal.
+    // Returns the number of matches that were changed.
+    int applyWithdrawals(const vector<ScheduleChange>& changes) {
+        if (is_empty()) {
+            cout << "No matches scheduled.\n";
+            return 0;
+        }
+
+        // Player -> positions in changes that target them, ascending
+        unordered_map<string, vector<int>> byPlayer;
+        for (int i = 0; i < static_cast<int>(changes.size()); i++) {
+            byPlayer[changes[i].player].push_back(i);
+        }
+
+        // First change aimed at playerName that comes after position after
+        auto nextChange = [&byPlayer](const string& playerName, int after) {
+            auto it = byPlayer.find(playerName);
+            if (it == byPlayer.end()) {
+                return INT_MAX;
+            }
+            auto pos = upper_bound(it->second.begin(), it->second.end(), after);
+            return pos == it->second.end() ? INT_MAX : *pos;
+        };
+
+        int affected = 0;
+
+        for (Match* temp = matches.front(); temp; temp = temp->next) {
+            bool changed = false;
+            int position = -1;
+
+            while (true) {
+                int next1 = nextChange(temp->player1, position);
+                int next2 = nextChange(temp->player2, position);
+                position = min(next1, next2);
+                if (position == INT_MAX) {
+                    break;
+                }
+
+                const ScheduleChange& change = changes[position];
+                if (change.substitute.empty()) {
+                    // Same rule as setPlayerAbsent: player1 first, otherwise player2
+                    if (next1 == position) {
+                        temp->attend1 = false;
+                    } else {
+                        temp->attend2 = false;
+                    }
+                } else {
+                    if (next1 == position) {
+                        temp->player1 = change.substitute;
+                    }
+                    if (next2 == position) {
+                        temp->player2 = change.substitute;
+                    }
+                }
+                changed = true;
+            }
+
+            if (changed) {
+                affected++;
+                cout << "Match updated: " << temp->player1 << (temp->attend1 ? "" : " (absent)")
+                     << " vs " << temp->player2 << (temp->attend2 ? "" : " (absent)") << ".\n";
+            }
+        }
+
+        return affected;
+    }
+
     //task 3 until here
 
 
@@ -586,7 +1405,9 @@ void displayMainMenu() {
     cout << "2. Ticket Sales & Spectator Management\n";
     cout << "3. Tournament & Player Management\n";
     cout << "4. Match History Tracking \n";
-    cout << "5. Exit\n";
+    cout << "5. Save Snapshot\n";
+    cout << "6. Hot-Path Statistics\n";
+    cout << "7. Exit\n";
     cout << "Choose an option: ";
 }
 
@@ -668,6 +1489,8 @@ string getCurrentTime() {
 }
 
 // Function to handle spectator registration
+const int EARLY_BIRD_SLOTS = 10;
+
 void registerSpectator(SpectatorManager& manager) {
     while (true) {
         cout << "Enter Spectator info:\n";
@@ -675,7 +1498,7 @@ void registerSpectator(SpectatorManager& manager) {
         int priority;
 
         // Display remaining Early-bird slots
-        int remainingEarlyBird = 10 - manager.getEarlyBirdCount();
+        int remainingEarlyBird = EARLY_BIRD_SLOTS - manager.getEarlyBirdCount();
         if (remainingEarlyBird > 0) {
             cout << "Remaining Early-bird slots: " << remainingEarlyBird << endl;
         } else {
@@ -715,10 +1538,104 @@ void registerSpectator(SpectatorManager& manager) {
     }
 }
 
+// Rebuild the entrance queue from everyone who has not entered or exited yet, and show it
+void showEntranceQueue(SpectatorManager& manager, PriorityQueue& entranceQueue) {
+    entranceQueue.clear(); // Clear the previous queue
+    Spectator* temp = manager.getHead(); // Get the head of all registered spectators
+    while (temp) {
+        // Only enqueue spectators who haven't entered or exited
+        if (!manager.hasEntered(temp->id) && !manager.hasExited(temp->id)) {
+            entranceQueue.enqueue(new Spectator(temp->id, temp->name, temp->priority, temp->registrationTime));
+        }
+        temp = temp->next;
+    }
+    entranceQueue.displayQueue("Entrance");
+}
+
+// Let everyone in the entrance queue into the venue, in priority order
+void admitEntranceQueue(SpectatorManager& manager, PriorityQueue& entranceQueue) {
+    if (entranceQueue.isEmpty()) {
+        cout << "\nNo spectators in the entrance queue.\n";
+        return;
+    }
+    cout << "\nSpectator(s) entering the venue now...\n";
+    cout << "----------------------------------------\n";
+    while (!entranceQueue.isEmpty()) {
+        Spectator* nextSpectator = entranceQueue.dequeue();
+        string priorityStr = (nextSpectator->priority == 0) ? "VIP" : (nextSpectator->priority == 1) ? "Early-bird" : "Normal";
+        cout << nextSpectator->name << " (" << priorityStr << ") entering...\n";
+        manager.removeSpectator(nextSpectator); // Remove from main list
+        manager.moveToEntered(nextSpectator); // Move to entered list
+    }
+}
+
+// Rebuild the exit queue from everyone inside the venue, and show it
+void showExitQueue(SpectatorManager& manager, PriorityQueue& exitQueue) {
+    exitQueue.clear(); // Clear the previous queue
+    Spectator* temp = manager.getEnteredHead(); // Get the head of entered spectators
+    if (!temp) {
+        cout << "\nNo spectators have entered the venue yet.\n";
+        return;
+    }
+    while (temp) {
+        // Only enqueue spectators who haven't exited
+        if (!manager.hasExited(temp->id)) {
+            exitQueue.enqueue(new Spectator(temp->id, temp->name, temp->priority, temp->registrationTime));
+        }
+        temp = temp->next;
+    }
+    exitQueue.displayQueue("Exit");
+}
+
+// Let everyone in the exit queue leave, in priority order
+void releaseExitQueue(SpectatorManager& manager, PriorityQueue& exitQueue) {
+    if (exitQueue.isEmpty()) {
+        cout << "\nNo spectators in the exit queue.\n";
+        return;
+    }
+    cout << "\nSpectator(s) exiting the venue now...\n";
+    cout << "----------------------------------------\n";
+    while (!exitQueue.isEmpty()) {
+        Spectator* nextSpectator = exitQueue.dequeue();
+        string priorityStr = (nextSpectator->priority == 0) ? "VIP" : (nextSpectator->priority == 1) ? "Early-bird" : "Normal";
+        cout << nextSpectator->name << " (" << priorityStr << ") exiting...\n";
+        manager.moveToExited(nextSpectator); // Move to exited list
+    }
+}
+
+// A spectator gives up waiting at the entrance and will not return; false if id is not queued
+bool leaveEntranceQueue(SpectatorManager& manager, PriorityQueue& entranceQueue, int id) {
+    Spectator* removedSpectator = entranceQueue.removeSpectator(id);
+    if (!removedSpectator) {
+        cout << "\nSpectator with ID " << id << " is not in the entrance queue.\n";
+        return false;
+    }
+    string priorityStr = (removedSpectator->priority == 0) ? "VIP" : (removedSpectator->priority == 1) ? "Early-bird" : "Normal";
+    cout << "\nSpectator with ID " << id << " (" << removedSpectator->name << ", " << priorityStr << ") has left the entrance queue and will not return.\n";
+    manager.moveToExited(removedSpectator); // Mark as exited; the exited list now owns this copy
+    entranceQueue.displayQueue("Entrance"); // Display the updated queue
+    return true;
+}
+
+// A spectator leaves the exit queue before being let out; false if id is not queued
+bool leaveExitQueue(PriorityQueue& exitQueue, int id) {
+    Spectator* removedSpectator = exitQueue.removeSpectator(id);
+    if (!removedSpectator) {
+        cout << "\nSpectator with ID " << id << " is not in the exit queue.\n";
+        return false;
+    }
+    string priorityStr = (removedSpectator->priority == 0) ? "VIP" : (removedSpectator->priority == 1) ? "Early-bird" : "Normal";
+    cout << "\nSpectator with ID " << id << " (" << removedSpectator->name << ", " << priorityStr << ") has left the exit queue.\n";
+    delete removedSpectator; // Free memory
+    exitQueue.displayQueue("Exit"); // Display the updated queue
+    return true;
+}
+
 void handleSpectatorMenu(SpectatorManager& manager, PriorityQueue& entranceQueue, PriorityQueue& exitQueue) {
     int choice;
 
     while (true) {
+        saveSnapshotIfDue();
         displayTSSMMainMenu();
         choice = getValidatedInput(1, 5); // Update the range to include the new option
 
@@ -744,110 +1661,32 @@ void handleSpectatorMenu(SpectatorManager& manager, PriorityQueue& entranceQueue
                     subChoice = getValidatedInput(1, 7); // Update the range to include new options
 
                     switch (subChoice) {
-                        case 1: { // Show Entrance Queueing Situation
-                            entranceQueue.clear(); // Clear the previous queue
-                            Spectator* temp = manager.getHead(); // Get the head of all registered spectators
-                            while (temp) {
-                                // Only enqueue spectators who haven't entered or exited
-                                if (!manager.hasEntered(temp->id) && !manager.hasExited(temp->id)) {
-                                    entranceQueue.enqueue(new Spectator(temp->id, temp->name, temp->priority, temp->registrationTime));
-                                }
-                                temp = temp->next;
-                            }
-                            entranceQueue.displayQueue("Entrance");
+                        case 1: // Show Entrance Queueing Situation
+                            showEntranceQueue(manager, entranceQueue);
                             break;
-                        }
-                        case 2: { // Entering the Venue Now
-                            if (entranceQueue.isEmpty()) {
-                                cout << "\nNo spectators in the entrance queue.\n";
-                            } else {
-                                cout << "\nSpectator(s) entering the venue now...\n";
-                                cout << "----------------------------------------\n";
-                                while (!entranceQueue.isEmpty()) {
-                                    Spectator* nextSpectator = entranceQueue.dequeue();
-                                    string priorityStr = (nextSpectator->priority == 0) ? "VIP" : (nextSpectator->priority == 1) ? "Early-bird" : "Normal";
-                                    cout << nextSpectator->name << " (" << priorityStr << ") entering...\n";
-                                    manager.removeSpectator(nextSpectator); // Remove from main list
-                                    manager.moveToEntered(nextSpectator); // Move to entered list
-                                }
-                            }
+                        case 2: // Entering the Venue Now
+                            admitEntranceQueue(manager, entranceQueue);
                             break;
-                        }
-                        case 3: { // Show Exit Queueing Situation
-                            exitQueue.clear(); // Clear the previous queue
-                            Spectator* temp = manager.getEnteredHead(); // Get the head of entered spectators
-                            if (!temp) {
-                                cout << "\nNo spectators have entered the venue yet.\n";
-                            } else {
-                                while (temp) {
-                                    // Only enqueue spectators who haven't exited
-                                    if (!manager.hasExited(temp->id)) {
-                                        exitQueue.enqueue(new Spectator(temp->id, temp->name, temp->priority, temp->registrationTime));
-                                    }
-                                    temp = temp->next;
-                                }
-                                exitQueue.displayQueue("Exit");
-                            }
+                        case 3: // Show Exit Queueing Situation
+                            showExitQueue(manager, exitQueue);
                             break;
-                        }
-                        case 4: { // Exiting the Venue Now
-                            if (exitQueue.isEmpty()) {
-                                cout << "\nNo spectators in the exit queue.\n";
-                            } else {
-                                cout << "\nSpectator(s) exiting the venue now...\n";
-                                cout << "----------------------------------------\n";
-                                while (!exitQueue.isEmpty()) {
-                                    Spectator* nextSpectator = exitQueue.dequeue();
-                                    string priorityStr = (nextSpectator->priority == 0) ? "VIP" : (nextSpectator->priority == 1) ? "Early-bird" : "Normal";
-                                    cout << nextSpectator->name << " (" << priorityStr << ") exiting...\n";
-                                    manager.moveToExited(nextSpectator); // Move to exited list
-                                }
-                            }
+                        case 4: // Exiting the Venue Now
+                            releaseExitQueue(manager, exitQueue);
                             break;
-                        }
-                        case 5: { // Leave Entrance Queue Early
+                        case 5: // Leave Entrance Queue Early
                             if (entranceQueue.isEmpty()) {
                                 cout << "\nNo spectators in the entrance queue to leave.\n";
                             } else {
-                                // Generate a random ID from the valid range
-                                int randomID = entranceQueue.getRandomID();
-                                if (randomID != -1) {
-                                    // Remove the spectator from the queue
-                                    Spectator* removedSpectator = entranceQueue.removeSpectator(randomID);
-                                    if (removedSpectator) {
-                                        string priorityStr = (removedSpectator->priority == 0) ? "VIP" : (removedSpectator->priority == 1) ? "Early-bird" : "Normal";
-                                        cout << "\nSpectator with ID " << randomID << " (" << removedSpectator->name << ", " << priorityStr << ") has left the entrance queue and will not return.\n";
-                                        manager.moveToExited(removedSpectator); // Mark as exited
-                                        delete removedSpectator; // Free memory
-                                    }
-                                    entranceQueue.displayQueue("Entrance"); // Display the updated queue
-                                } else {
-                                    cout << "\nNo valid spectators found in the entrance queue.\n";
-                                }
+                                leaveEntranceQueue(manager, entranceQueue, entranceQueue.getRandomID());
                             }
                             break;
-                        }
-                        case 6: { // Leave Exit Queue Early
+                        case 6: // Leave Exit Queue Early
                             if (exitQueue.isEmpty()) {
                                 cout << "\nNo spectators in the exit queue to leave.\n";
                             } else {
-                                // Generate a random ID from the valid range
-                                int randomID = exitQueue.getRandomID();
-                                if (randomID != -1) {
-                                    // Remove the spectator from the queue
-                                    Spectator* removedSpectator = exitQueue.removeSpectator(randomID);
-                                    if (removedSpectator) {
-                                        string priorityStr = (removedSpectator->priority == 0) ? "VIP" : (removedSpectator->priority == 1) ? "Early-bird" : "Normal";
-                                        cout << "\nSpectator with ID " << randomID << " (" << removedSpectator->name << ", " << priorityStr << ") has left the exit queue.\n";
-                                        delete removedSpectator; // Free memory
-                                    }
-                                    exitQueue.displayQueue("Exit"); // Display the updated queue
-                                } else {
-                                    cout << "\nNo valid spectators found in the exit queue.\n";
-                                }
+                                leaveExitQueue(exitQueue, exitQueue.getRandomID());
                             }
                             break;
-                        }
                         case 7: // Exit to Main Menu
                             cout << "Returning to Ticket Sales & Spectator Management Main Menu...\n";
                             break;
@@ -909,9 +1748,7 @@ void processQualifiers(TournamentScheduler &queue, WinnerList &winnersList)
         }
 
         cout << "\nProcessing Qualifying Matches:\n";
-        Match *temp = queue.getFront();
-
-        do
+        for (Match *temp = queue.getFront(); temp; temp = temp->next)
         {
             if (!temp->attend1)
             {
@@ -943,8 +1780,7 @@ void processQualifiers(TournamentScheduler &queue, WinnerList &winnersList)
                     }
                 }
             }
-            temp = temp->next;
-        } while (temp != queue.getFront());
+        }
 
         // Clear the queue after processing
         queue.clearQueue();
@@ -1043,53 +1879,30 @@ void determineTopWinners(Group &group, WinnerList &knockoutPlayers)
     cout << "Top 2 winners from group: " << participantsWithWins[0].first << " and " << participantsWithWins[1].first << endl;
 }
 
-// Function to get the size of the linked list
-int getListSize(WinnerNode *head)
-{
-    int size = 0;
-    WinnerNode *temp = head;
-    while (temp)
-    {
-        size++;
-        temp = temp->next;
-    }
-    return size;
-}
-
-// Function to get a node at a specific index
-WinnerNode *getNodeAtIndex(WinnerNode *head, int index)
-{
-    WinnerNode *temp = head;
-    for (int i = 0; i < index && temp; i++)
-    {
-        temp = temp->next;
-    }
-    return temp;
-}
-
 // Function to shuffle the linked list
 void shuffleKnockoutPlayers(WinnerList &knockoutPlayers)
 {
-    int size = getListSize(knockoutPlayers.getHead());
-    if (size <= 1)
+    if (knockoutPlayers.size() <= 1)
         return; // No need to shuffle if there's only one player
 
+    // Collect the nodes once so every swap below is O(1)
+    vector<WinnerNode *> nodes;
+    nodes.reserve(knockoutPlayers.size());
+    for (WinnerNode *temp = knockoutPlayers.getHead(); temp; temp = temp->next)
+    {
+        nodes.push_back(temp);
+    }
+
     // Seed the random number generator
     srand(time(0));
 
     // Perform Fisher-Yates shuffle on the linked list
-    for (int i = size - 1; i > 0; i--)
+    for (int i = static_cast<int>(nodes.size()) - 1; i > 0; i--)
     {
         int j = rand() % (i + 1); // Random index between 0 and i
 
         // Swap the data of nodes at positions i and j
-        WinnerNode *node1 = getNodeAtIndex(knockoutPlayers.getHead(), i);
-        WinnerNode *node2 = getNodeAtIndex(knockoutPlayers.getHead(), j);
-
-        if (node1 && node2)
-        {
-            swap(node1->winner, node2->winner);
-        }
+        swap(nodes[i]->winner, nodes[j]->winner);
     }
 }
 
@@ -1150,7 +1963,7 @@ void simulateKnockoutStage(WinnerList &knockoutPlayers)
         }
 
         // Update the knockoutPlayers list for the next round
-        knockoutPlayers = nextRound;
+        knockoutPlayers = move(nextRound);
     }
 }
 
@@ -1160,6 +1973,7 @@ void handleTournamentMenu(TournamentScheduler &tournament, WinnerList &winnersLi
 
     do
     {
+        saveSnapshotIfDue();
         cout << "\n--- Tournament Management Menu ---\n";
         cout << "1. Schedule Qualifier Match\n";
         cout << "2. Display Scheduled Matches\n";
@@ -1237,87 +2051,225 @@ void handleTournamentMenu(TournamentScheduler &tournament, WinnerList &winnersLi
 // ==================== Tournament & Player Management (HENG JUN YONG TP073769 part) ====================
 
 // Structure to represent a withdrawal
-struct Withdrawal {
+struct Withdrawal : IntrusiveNode<Withdrawal> {
     string playerName;
     string substituteName;  // Empty string indicates no substitute
     bool processed;
-    Withdrawal* next;
 
-    Withdrawal(string p, string s = "") : playerName(p), substituteName(s), processed(false), next(nullptr) {}
+    Withdrawal(string p, string s = "") : playerName(p), substituteName(s), processed(false) {}
+};
+
+// Union-find over player names: every withdrawn entrant points towards the player
+// who replaced them, so following the parents gives the current active stand-in.
+// Paths are compressed on every lookup, so long substitution chains stay cheap.
+class StandInResolver {
+private:
+    unordered_map<string, string> parent; // Withdrawn player -> their substitute
+
+public:
+    // Return the player currently standing in for the given entrant
+    string resolve(const string& playerName) {
+        string root = playerName;
+        auto it = parent.find(root);
+        while (it != parent.end()) {
+            root = it->second;
+            it = parent.find(root);
+        }
+
+        // Path compression: point every player on the chain straight at the root
+        string current = playerName;
+        while (current != root) {
+            string& next = parent[current];
+            string following = next;
+            next = root;
+            current = following;
+        }
+        return root;
+    }
+
+    // Record that the active stand-in for original is now substitute's active stand-in
+    // Returns false if both already resolve to the same player
+    bool link(const string& original, const string& substitute) {
+        string from = resolve(original);
+        string to = resolve(substitute);
+        if (from == to) {
+            return false;
+        }
+        parent[from] = to;
+        return true;
+    }
+
+    bool isReplaced(const string& playerName) {
+        return parent.count(playerName) > 0;
+    }
+
+    void saveSnapshot(SnapshotWriter& out) {
+        out.putInt(static_cast<int>(parent.size()));
+        for (const auto& entry : parent) {
+            out.putString(entry.first);
+            out.putString(entry.second);
+        }
+    }
+
+    void loadSnapshot(SnapshotReader::Cursor& in) {
+        int count = in.getCount(4);
+        for (int i = 0; i < count; i++) {
+            string player = in.getString();
+            parent[player] = in.getString();
+        }
+    }
 };
 
 // Class to manage player withdrawals
+// Pending withdrawals wait in a FIFO queue. Once processed they move to a
+// processed list that only keeps the newest retentionLimit records; older
+// ones are appended to WITHDRAWAL_ARCHIVE_FILENAME and freed.
 class WithdrawalQueue {
 private:
-    Withdrawal* front;
-    Withdrawal* rear;
+    IntrusiveList<Withdrawal> pending;    // Pending queue
+    IntrusiveList<Withdrawal> processed;  // Processed records, oldest first
+    int archivedCount;
+    int retentionLimit;             // Max processed records kept in memory
+    unordered_map<string, vector<Withdrawal*>> playerIndex; // Player -> records in arrival order
+    unordered_map<string, int> archivedPerPlayer;           // Player -> records moved to the archive file
+    StandInResolver standIns;       // Withdrawn player -> current active stand-in
+    set<string> absentPlayers;      // Active players who withdrew without a substitute
+    const string WITHDRAWAL_ARCHIVE_FILENAME = "withdrawal_archive.txt";
 
 public:
-    WithdrawalQueue() : front(nullptr), rear(nullptr) {}
+    WithdrawalQueue(int retention = 100) : archivedCount(0), retentionLimit(retention) {}
 
-    ~WithdrawalQueue() {
-        while (front != nullptr) {
-            Withdrawal* temp = front;
-            front = front->next;
-            delete temp;
-        }
+    // Change how many processed records are kept in memory
+    void setRetentionLimit(int limit) {
+        retentionLimit = limit < 0 ? 0 : limit;
+        archiveOldRecords();
+    }
+
+    int getRetentionLimit() {
+        return retentionLimit;
     }
 
     void enqueueWithdrawal(const string& playerName, const string& substituteName = "") {
         Withdrawal* newNode = new Withdrawal(playerName, substituteName);
-
-        if (rear == nullptr) {
-            front = rear = newNode;
-        } else {
-            rear->next = newNode;
-            rear = newNode;
-        }
+        pending.pushBack(newNode);
+        playerIndex[playerName].push_back(newNode);
 
         cout << "Player " << playerName << " has withdrawn";
         if (!substituteName.empty()) {
             cout << " and will be replaced by Player " << substituteName;
         }
         cout << ".\n";
+
+        if (standIns.isReplaced(playerName)) {
+            cout << "Note: Player " << playerName << " is currently played by " << standIns.resolve(playerName)
+                 << ", so this withdrawal will apply to them.\n";
+        }
+    }
+
+    // Who actually plays in the slot originally given to playerName
+    string resolveStandIn(const string& playerName) {
+        return standIns.resolve(playerName);
+    }
+
+    // Show the active stand-in for a player
+    void displayStandIn(const string& playerName) {
+        string active = standIns.resolve(playerName);
+        if (active == playerName) {
+            cout << "Player " << playerName << " has not been replaced";
+        } else {
+            cout << "Player " << playerName << " is currently played by " << active;
+        }
+        if (absentPlayers.count(active)) {
+            cout << " (withdrawn, no substitute)";
+        }
+        cout << ".\n";
     }
 
 
     void processWithdrawal(TournamentScheduler& scheduler) {
-        if (front == nullptr) {
+        if (pending.empty()) {
             cout << "No withdrawals to process.\n";
             return;
         }
 
-        Withdrawal* temp = front;
+        Withdrawal* temp = pending.popFront();
         cout << "Processing withdrawal: Player " << temp->playerName;
 
+        // The withdrawing slot may already be played by a stand-in
+        string active = standIns.resolve(temp->playerName);
+        if (active != temp->playerName) {
+            cout << " (currently played by " << active << ")";
+        }
+
         // Update the match data
         if (!temp->substituteName.empty()) {
-            cout << " (Substitute: Player " << temp->substituteName << ")";
-            // Replace the player name with the substitute in all matches
-            scheduler.replacePlayer(temp->playerName, temp->substituteName);
+            string substitute = standIns.resolve(temp->substituteName);
+            cout << " (Substitute: Player " << substitute << ")";
+            cout << endl;
+            if (standIns.link(active, substitute)) {
+                // Replace the player name with the substitute in all matches
+                scheduler.replacePlayer(active, substitute);
+            } else {
+                cout << "Player " << substitute << " is already standing in for " << temp->playerName << ".\n";
+            }
         } else {
             cout << " (No substitute available)";
+            cout << endl;
+            absentPlayers.insert(active);
             // Set attendance to false for this player
-            scheduler.setPlayerAbsent(temp->playerName);
+            scheduler.setPlayerAbsent(active);
         }
-        cout << endl;
 
         temp->processed = true;
-        if (front == rear) {
-            front = rear = nullptr;
-        } else {
-            front = front->next;
+        processed.pushBack(temp);
+        archiveOldRecords();
+    }
+
+    // Process every pending withdrawal at once. Each withdrawal only updates the
+    // stand-in union-find and records its change against the player active at
+    // that moment, then the batch is applied to the schedule in a single pass.
+    void processAllWithdrawals(TournamentScheduler& scheduler) {
+        if (pending.empty()) {
+            cout << "No withdrawals to process.\n";
+            return;
         }
 
-//        front = front->next;
-//        if (front == nullptr) rear = nullptr;
-//
-//        delete temp;
+        int batchCount = 0;
+        vector<ScheduleChange> changes;
+
+        Withdrawal* temp = pending.front();
+        while (temp != nullptr) {
+            string active = standIns.resolve(temp->playerName);
+            if (!temp->substituteName.empty()) {
+                string substitute = standIns.resolve(temp->substituteName);
+                if (standIns.link(active, substitute)) {
+                    changes.emplace_back(active, substitute);
+                }
+            } else {
+                absentPlayers.insert(active);
+                changes.emplace_back(active, "");
+            }
+
+            temp->processed = true;
+            batchCount++;
+            temp = temp->next;
+        }
+
+        cout << "Processing " << batchCount << " pending withdrawal(s)...\n";
+        int affected = scheduler.applyWithdrawals(changes);
+        cout << batchCount << " withdrawal(s) processed, " << affected << " match(es) affected.\n";
+
+        // Splice the whole pending queue onto the processed list
+        processed.splice(pending);
+        archiveOldRecords();
     }
 
     void displayAllWithdrawals() {
-        if (front == nullptr) {
+        if (pending.empty() && processed.empty()) {
             cout << "No withdrawal records." << endl;
+            if (archivedCount > 0) {
+                cout << archivedCount << " older record(s) archived in " << WITHDRAWAL_ARCHIVE_FILENAME << "." << endl;
+            }
             return;
         }
 
@@ -1326,54 +2278,175 @@ public:
         cout << "Player Name | Substitute Name | Status\n";
         cout << "------------------------------------------------------\n";
 
-        Withdrawal* current = front;
-        bool hasRecords = false;
-        int count = 0;
+        displayList(processed);
+        displayList(pending);
 
-        do {
-            cout << current->playerName << " | "
-                 << (current->substituteName.empty() ? "None" : current->substituteName) << " | "
-                 << (current->processed ? "Processed" : "Pending") << endl;
-            current = current->next;
-        } while (current != front && current != nullptr);
+        cout << "------------------------------------------------------\n";
+        cout << "Pending: " << pending.size() << ", Processed: " << processed.size()
+             << ", Archived: " << archivedCount << "\n";
+    }
 
+    // Display only the withdrawals still waiting to be processed
+    void displayPendingWithdrawals() {
+        if (pending.empty()) {
+            cout << "No pending withdrawals." << endl;
+            return;
+        }
 
+        cout << "\nPending Withdrawals (" << pending.size() << "):\n";
+        cout << "------------------------------------------------------\n";
+        displayList(pending);
         cout << "------------------------------------------------------\n";
     }
 
+    // Display the processed withdrawals still kept in memory
+    void displayProcessedWithdrawals() {
+        if (processed.empty()) {
+            cout << "No processed withdrawals in memory." << endl;
+        } else {
+            cout << "\nProcessed Withdrawals (newest " << processed.size() << "):\n";
+            cout << "------------------------------------------------------\n";
+            displayList(processed);
+            cout << "------------------------------------------------------\n";
+        }
+        if (archivedCount > 0) {
+            cout << archivedCount << " older record(s) archived in " << WITHDRAWAL_ARCHIVE_FILENAME << "." << endl;
+        }
+    }
+
 
     void searchWithdrawal(const string& playerName) {
-        if (front == nullptr) {
+        if (pending.empty() && processed.empty() && archivedCount == 0) {
             cout << "No withdrawals in the system." << endl;
             return;
         }
 
-        bool found = false;
-        Withdrawal* current = front;
-
         cout << "\nWithdrawal records for Player " << playerName << ":\n";
         cout << "------------------------------------------------------\n";
-        cout << "Substitute Name\n";
+        cout << "Substitute Name | Status\n";
         cout << "------------------------------------------------------\n";
 
-        while (current != nullptr) {
-            if (current->playerName == playerName) {
-                if (current->substituteName.empty()) {
-                    cout << "None";
-                } else {
-                    cout << current->substituteName;
-                }
-                cout << endl;
-                found = true;
+        auto it = playerIndex.find(playerName);
+        if (it != playerIndex.end()) {
+            for (Withdrawal* current : it->second) {
+                cout << (current->substituteName.empty() ? "None" : current->substituteName) << " | "
+                     << (current->processed ? "Processed" : "Pending") << endl;
             }
-            current = current->next;
         }
 
-        if (!found) {
+        auto archived = archivedPerPlayer.find(playerName);
+        if (archived != archivedPerPlayer.end()) {
+            cout << archived->second << " older record(s) in " << WITHDRAWAL_ARCHIVE_FILENAME << endl;
+        }
+
+        if (it == playerIndex.end() && archived == archivedPerPlayer.end()) {
             cout << "No withdrawal records found for Player " << playerName << "." << endl;
         }
         cout << "------------------------------------------------------\n";
     }
+
+    void saveSnapshot(SnapshotWriter& out) {
+        out.putInt(retentionLimit);
+        out.putInt(archivedCount);
+        saveList(out, processed);
+        saveList(out, pending);
+        out.putInt(static_cast<int>(archivedPerPlayer.size()));
+        for (const auto& entry : archivedPerPlayer) {
+            out.putString(entry.first);
+            out.putInt(entry.second);
+        }
+        out.putInt(static_cast<int>(absentPlayers.size()));
+        for (const string& player : absentPlayers) {
+            out.putString(player);
+        }
+        standIns.saveSnapshot(out);
+    }
+
+    // Restore the state of a queue that has no withdrawals yet
+    void loadSnapshot(SnapshotReader::Cursor& in) {
+        retentionLimit = in.getInt();
+        archivedCount = in.getInt();
+        loadList(in, processed, true);
+        loadList(in, pending, false);
+        int archivedPlayers = in.getCount(3);
+        for (int i = 0; i < archivedPlayers; i++) {
+            string player = in.getString();
+            archivedPerPlayer[player] = in.getInt();
+        }
+        int absent = in.getCount(2);
+        for (int i = 0; i < absent; i++) {
+            absentPlayers.insert(in.getString());
+        }
+        standIns.loadSnapshot(in);
+    }
+
+private:
+    static void saveList(SnapshotWriter& out, const IntrusiveList<Withdrawal>& records) {
+        out.putInt(static_cast<int>(records.size()));
+        for (const Withdrawal& record : records) {
+            out.putString(record.playerName);
+            out.putString(record.substituteName);
+        }
+    }
+
+    // Rebuild one list from the snapshot and add its records to the player index
+    void loadList(SnapshotReader::Cursor& in, IntrusiveList<Withdrawal>& records, bool isProcessed) {
+        int count = in.getCount(4);
+        for (int i = 0; i < count; i++) {
+            string player = in.getString();
+            Withdrawal* record = new Withdrawal(player, in.getString());
+            record->processed = isProcessed;
+            records.pushBack(record);
+            playerIndex[player].push_back(record);
+        }
+    }
+
+    void displayList(const IntrusiveList<Withdrawal>& records) {
+        for (const Withdrawal& record : records) {
+            cout << record.playerName << " | "
+                 << (record.substituteName.empty() ? "None" : record.substituteName) << " | "
+                 << (record.processed ? "Processed" : "Pending") << endl;
+        }
+    }
+
+    // Move the oldest processed records to the archive file until the retention limit holds
+    void archiveOldRecords() {
+        if (static_cast<long long>(processed.size()) <= retentionLimit) {
+            return;
+        }
+
+        ofstream archiveFile(WITHDRAWAL_ARCHIVE_FILENAME, ios::app);
+        if (!archiveFile) {
+            // Keep everything in memory rather than lose records
+            cout << "Error opening " << WITHDRAWAL_ARCHIVE_FILENAME << "! Processed withdrawals stay in memory.\n";
+            return;
+        }
+
+        while (static_cast<long long>(processed.size()) > retentionLimit) {
+            Withdrawal* oldest = processed.front();
+            archiveFile << oldest->playerName << "," << oldest->substituteName << "\n";
+            archiveFile.flush();
+            if (!archiveFile) {
+                cout << "Error writing " << WITHDRAWAL_ARCHIVE_FILENAME << "! Processed withdrawals stay in memory.\n";
+                return;
+            }
+            processed.popFront();
+
+            // Processed records always come before pending ones in a player's index entry
+            auto it = playerIndex.find(oldest->playerName);
+            if (it != playerIndex.end()) {
+                vector<Withdrawal*>& records = it->second;
+                records.erase(std::find(records.begin(), records.end(), oldest));
+                if (records.empty()) {
+                    playerIndex.erase(it);
+                }
+            }
+            archivedPerPlayer[oldest->playerName]++;
+            archivedCount++;
+
+            delete oldest;
+        }
+    }
 };
 
 // Function to handle player withdrawal
@@ -1422,16 +2495,21 @@ void handleWithdrawalMenu(WithdrawalQueue &queue, TournamentScheduler &tournamen
     int subChoice;
 
     while (true) {
+        saveSnapshotIfDue();
         cout << "\n === Withdrawal Management === \n";
         cout << "1. Register Player Withdrawal\n";
         cout << "2. View All Withdrawals\n";
         cout << "3. Search for Withdrawals by Player\n";
         cout << "4. Process Next Withdrawal\n";
-        cout << "5. Return to Main Menu\n";
+        cout << "5. Process All Pending Withdrawals\n";
+        cout << "6. View Pending Withdrawals\n";
+        cout << "7. View Processed Withdrawals\n";
+        cout << "8. Find Active Stand-in for a Player\n";
+        cout << "9. Return to Main Menu\n";
         cout << "Enter choice: ";
         cin >> subChoice;
 
-        if (subChoice == 5) {
+        if (subChoice == 9) {
             cout << "Returning to main menu...\n";
             break;
         }
@@ -1449,6 +2527,23 @@ void handleWithdrawalMenu(WithdrawalQueue &queue, TournamentScheduler &tournamen
             case 4:
                 queue.processWithdrawal(tournament);
                 break;
+            case 5:
+                queue.processAllWithdrawals(tournament);
+                break;
+            case 6:
+                queue.displayPendingWithdrawals();
+                break;
+            case 7:
+                queue.displayProcessedWithdrawals();
+                break;
+            case 8: {
+                string playerName;
+                cin.ignore(); // Clear input buffer
+                cout << "Enter Player Name: ";
+                getline(cin, playerName);
+                queue.displayStandIn(playerName);
+                break;
+            }
             default:
                 cout << "Invalid option. Please try again.\n";
         }
@@ -1457,7 +2552,87 @@ void handleWithdrawalMenu(WithdrawalQueue &queue, TournamentScheduler &tournamen
 
 
 // TESHWINDEV SINGH BHATT TP068387 MATCH HISTORY TRACKING
-struct MatchHistory {
+
+// Held while writing to cout from code that may run on several threads
+mutex consoleMutex;
+
+// Collects console output and prints it in one piece under consoleMutex when it
+// goes out of scope, so slow work is never done while holding the console
+class LockedOutput : public ostringstream {
+public:
+    ~LockedOutput() {
+        if (tellp() > 0) {
+            lock_guard<mutex> lock(consoleMutex);
+            cout << str();
+            cout.flush();
+        }
+    }
+};
+
+// Match dates are stored as epoch days (days since 1970-01-01)
+const int32_t INVALID_EPOCH_DAY = INT32_MIN;
+
+// Days since 1970-01-01 for a calendar date (days-from-civil, proleptic Gregorian calendar)
+int32_t civilToEpochDay(int y, int m, int d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int>(doe) - 719468;
+}
+
+// Length of month m in year y, with Gregorian leap years
+int daysInMonth(int y, int m) {
+    static const int DAYS[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return (m == 2 && leap) ? 29 : DAYS[m - 1];
+}
+
+// Convert a YYYY-MM-DD date to an epoch day (INVALID_EPOCH_DAY if it cannot be parsed
+// or does not exist), so every accepted date is written back exactly as it was read
+int32_t dateToEpochDay(string_view date) {
+    auto parseField = [&date](size_t first, size_t last, int& value) {
+        from_chars_result result = from_chars(date.data() + first, date.data() + last, value);
+        return result.ec == errc() && result.ptr == date.data() + last;
+    };
+    int y = 0, m = 0, d = 0;
+    if (date.size() != 10 || date[4] != '-' || date[7] != '-' ||
+        !parseField(0, 4, y) || !parseField(5, 7, m) || !parseField(8, 10, d) ||
+        m < 1 || m > 12 || d < 1 || d > daysInMonth(y, m)) {
+        return INVALID_EPOCH_DAY;
+    }
+    return civilToEpochDay(y, m, d);
+}
+
+// Convert days since 1970-01-01 back to a YYYY-MM-DD string
+string epochDayToDate(int32_t epochDay) {
+    if (epochDay == INVALID_EPOCH_DAY) {
+        return "Unknown";
+    }
+    const int z = epochDay + 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    const int y = static_cast<int>(yoe) + era * 400 + (m <= 2);
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u", y, m, d);
+    return string(buffer);
+}
+
+// Today's date as an epoch day, in local time
+int32_t todayEpochDay() {
+    time_t now = time(nullptr);
+    tm* localTime = localtime(&now);
+    return civilToEpochDay(localTime->tm_year + 1900, localTime->tm_mon + 1, localTime->tm_mday);
+}
+
+struct MatchHistory : IntrusiveNode<MatchHistory> {
     int matchID;
     string player1;
     string player2;
@@ -1465,20 +2640,19 @@ struct MatchHistory {
     int score2;
     string winner;
     string stage;
-    string date;
-    MatchHistory* next;
+    int32_t epochDay;       // Match date as days since 1970-01-01
 
-    MatchHistory(int id, string p1, string p2, int s1, int s2, string win, string stg = "Unknown", string dt = "")
-        : matchID(id), player1(p1), player2(p2), score1(s1), score2(s2), winner(win),
-          stage(stg), date(dt), next(nullptr) {
-        // If date is empty, use current date
-        if (dt.empty()) {
-            time_t now = time(nullptr);
-            tm* localTime = localtime(&now);
-            char buffer[11]; // YYYY-MM-DD + null terminator
-            strftime(buffer, sizeof(buffer), "%Y-%m-%d", localTime);
-            date = string(buffer);
-        }
+    MatchHistory(int id, string p1, string p2, int s1, int s2, string win, string stg = "Unknown", string_view dt = "")
+        : matchID(id), player1(move(p1)), player2(move(p2)), score1(s1), score2(s2), winner(move(win)),
+          stage(move(stg)), epochDay(dt.empty() ? todayEpochDay() : dateToEpochDay(dt)) {}
+
+    MatchHistory(int id, string p1, string p2, int s1, int s2, string win, string stg, int32_t day)
+        : matchID(id), player1(move(p1)), player2(move(p2)), score1(s1), score2(s2), winner(move(win)),
+          stage(move(stg)), epochDay(day) {}
+
+    // Match date as YYYY-MM-DD
+    string date() const {
+        return epochDayToDate(epochDay);
     }
 };
 
@@ -1489,375 +2663,3651 @@ struct PlayerStats {
     int matchesWon;
     int totalPointsScored;
     double winRate;
-    PlayerStats* next;
+    double rating;          // Elo rating, every player starts at 1500
 
-    PlayerStats(string name) : playerName(name), matchesPlayed(0), matchesWon(0),
-                             totalPointsScored(0), winRate(0.0), next(nullptr) {}
+    PlayerStats(string name) : playerName(move(name)), matchesPlayed(0), matchesWon(0),
+                             totalPointsScored(0), winRate(0.0), rating(1500.0) {}
 };
 
-class MatchHistoryTracker {
+// Player statistics kept in one contiguous array, in the order players were first
+// seen, with an open-addressing hash index (linear probing) from player name to
+// array position. Lookup-or-insert is O(1) and scanning all players walks memory
+// sequentially.
+class PlayerStatsTable {
 private:
-    MatchHistory* top;
-    PlayerStats* statsHead;
-    const string MATCH_FILENAME = "match_history.txt";
-    const string STATS_FILENAME = "player_stats.txt";
-    int nextMatchID;
+    struct Slot {
+        int32_t index;   // Position in players, -1 if the slot is empty
+        uint32_t hash;   // Cached hash so growing the index never rehashes names
+    };
+
+    vector<PlayerStats> players;
+    vector<Slot> slots;  // Capacity is a power of two, kept at most half full
+
+    static uint32_t hashName(string_view name) {
+        return static_cast<uint32_t>(std::hash<string_view>()(name));
+    }
+
+    void growIndex() {
+        vector<Slot> bigger(slots.empty() ? 16 : slots.size() * 2, Slot{-1, 0});
+        size_t mask = bigger.size() - 1;
+        for (const Slot& slot : slots) {
+            if (slot.index >= 0) {
+                size_t pos = slot.hash & mask;
+                while (bigger[pos].index >= 0) pos = (pos + 1) & mask;
+                bigger[pos] = slot;
+            }
+        }
+        slots.swap(bigger);
+    }
+
+    // Slot holding name, or the empty slot where it would go
+    size_t probe(string_view name, uint32_t hash) const {
+        size_t mask = slots.size() - 1;
+        size_t pos = hash & mask;
+        while (slots[pos].index >= 0) {
+            if (slots[pos].hash == hash && players[slots[pos].index].playerName == name) {
+                break;
+            }
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
 
 public:
-    MatchHistoryTracker() : top(nullptr), statsHead(nullptr), nextMatchID(1) {
-        loadFromFile();
+    size_t size() const { return players.size(); }
+    bool empty() const { return players.empty(); }
+
+    PlayerStats& operator[](size_t index) { return players[index]; }
+    const PlayerStats& operator[](size_t index) const { return players[index]; }
+
+    vector<PlayerStats>::iterator begin() { return players.begin(); }
+    vector<PlayerStats>::iterator end() { return players.end(); }
+    vector<PlayerStats>::const_iterator begin() const { return players.begin(); }
+    vector<PlayerStats>::const_iterator end() const { return players.end(); }
+
+    // Position of a player in the table, or -1
+    int indexOf(string_view name) const {
+        if (slots.empty()) return -1;
+        return slots[probe(name, hashName(name))].index;
     }
 
-    ~MatchHistoryTracker() {
-        saveToFile();
-        while (top) {
-            MatchHistory* temp = top;
-            top = top->next;
-            delete temp;
+    // Position of a player, adding an empty entry if they are new
+    int findOrCreate(string_view name) {
+        ProbeScope scope(PROBE_FIND_OR_CREATE_PLAYER);
+        if ((players.size() + 1) * 2 > slots.size()) {
+            growIndex();
         }
-        while (statsHead) {
-            PlayerStats* temp = statsHead;
-            statsHead = statsHead->next;
-            delete temp;
+        uint32_t hash = hashName(name);
+        size_t pos = probe(name, hash);
+        scope.visit(((pos - (hash & (slots.size() - 1))) & (slots.size() - 1)) + 1); // Slots examined
+        if (slots[pos].index < 0) {
+            slots[pos] = Slot{static_cast<int32_t>(players.size()), hash};
+            players.emplace_back(string(name));
         }
+        return slots[pos].index;
     }
 
-    // Records a new match and updates statistics
-    void recordMatch(string player1, string player2, int score1, int score2, string stage = "Unknown") {
-        string winner = (score1 > score2) ? player1 : player2;
+    PlayerStats* find(string_view name) {
+        int index = indexOf(name);
+        return index >= 0 ? &players[index] : nullptr;
+    }
 
-        MatchHistory* newMatch = new MatchHistory(nextMatchID++, player1, player2, score1, score2, winner, stage);
+    void clear() {
+        players.clear();
+        slots.clear();
+    }
+};
 
-        newMatch->next = top;
-        top = newMatch;
+// Order-statistic treap ranking players by one score, highest first (ties go to the
+// player seen first). Each player has one node, stored at the player's position in
+// the stats table, and every node tracks the size of its subtree, so updating a
+// score, finding the k-th player and finding a player's rank are all O(log n).
+class RankedLeaderboard {
+private:
+    struct Node {
+        double score;
+        int left;
+        int right;
+        int size;
+        uint32_t priority;
+        bool present;
+    };
+
+    vector<Node> nodes;
+    int root;
+    uint32_t seed;
+
+    uint32_t nextPriority() {
+        // xorshift32, only needs to look random to keep the treap balanced
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
 
-        updatePlayerStats(player1, score1, (winner == player1));
-        updatePlayerStats(player2, score2, (winner == player2));
+    int sizeOf(int node) const {
+        return node < 0 ? 0 : nodes[node].size;
+    }
 
-        cout << "Match recorded successfully!" << endl;
-        saveToFile();
+    void pull(int node) {
+        nodes[node].size = 1 + sizeOf(nodes[node].left) + sizeOf(nodes[node].right);
     }
 
-    // Display all match history
-    void displayMatchHistory() {
-        if (!top) {
-            cout << "No match history available." << endl;
+    // True if player a ranks ahead of player b
+    bool ahead(int a, int b) const {
+        return nodes[a].score > nodes[b].score || (nodes[a].score == nodes[b].score && a < b);
+    }
+
+    // Split tree into players ranked ahead of key (left) and the rest (right)
+    void split(int tree, int key, int& left, int& right) {
+        if (tree < 0) {
+            left = right = -1;
             return;
         }
+        if (ahead(tree, key)) {
+            split(nodes[tree].right, key, nodes[tree].right, right);
+            left = tree;
+        } else {
+            split(nodes[tree].left, key, left, nodes[tree].left);
+            right = tree;
+        }
+        pull(tree);
+    }
 
-        cout << "\n===== MATCH HISTORY =====\n";
-        cout << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
-        cout << "| Match ID |    Player 1    |    Player 2    | Score1 | Score2 |     Winner     |     Stage      |    Date    |\n";
-        cout << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+    int merge(int left, int right) {
+        if (left < 0) return right;
+        if (right < 0) return left;
+        if (nodes[left].priority > nodes[right].priority) {
+            nodes[left].right = merge(nodes[left].right, right);
+            pull(left);
+            return left;
+        }
+        nodes[right].left = merge(left, nodes[right].left);
+        pull(right);
+        return right;
+    }
 
-        MatchHistory* temp = top;
-        while (temp) {
-            cout << "| " << setw(8) << temp->matchID << " | "
-                 << setw(14) << temp->player1 << " | "
-                 << setw(14) << temp->player2 << " | "
-                 << setw(6) << temp->score1 << " | "
-                 << setw(6) << temp->score2 << " | "
-                 << setw(14) << temp->winner << " | "
-                 << setw(14) << temp->stage << " | "
-                 << setw(10) << temp->date << " |\n";
-            temp = temp->next;
+    int eraseNode(int tree, int key) {
+        if (tree == key) {
+            return merge(nodes[tree].left, nodes[tree].right);
         }
-        cout << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+        if (ahead(key, tree)) {
+            nodes[tree].left = eraseNode(nodes[tree].left, key);
+        } else {
+            nodes[tree].right = eraseNode(nodes[tree].right, key);
+        }
+        pull(tree);
+        return tree;
     }
 
-    // Search match by ID
-    void searchMatchByID(int matchID) {
-        MatchHistory* temp = top;
-        bool found = false;
+public:
+    RankedLeaderboard() : root(-1), seed(2463534242u) {}
 
-        while (temp) {
-            if (temp->matchID == matchID) {
-                found = true;
-                cout << "\n===== MATCH DETAILS =====\n";
-                cout << "Match ID: " << temp->matchID << "\n"
-                     << "Date: " << temp->date << "\n"
-                     << "Stage: " << temp->stage << "\n"
-                     << "Player 1: " << temp->player1 << "\n"
-                     << "Player 2: " << temp->player2 << "\n"
-                     << "Score: " << temp->score1 << " - " << temp->score2 << "\n"
-                     << "Winner: " << temp->winner << "\n";
-                break;
+    int size() const {
+        return sizeOf(root);
+    }
+
+    bool contains(int player) const {
+        return player >= 0 && player < static_cast<int>(nodes.size()) && nodes[player].present;
+    }
+
+    // Insert the player, or move them to their new score
+    void set(int player, double score) {
+        if (contains(player)) {
+            if (nodes[player].score == score) return;
+            erase(player);
+        }
+        if (player >= static_cast<int>(nodes.size())) {
+            nodes.resize(player + 1, Node{0.0, -1, -1, 1, 0, false});
+        }
+        Node& node = nodes[player];
+        node = Node{score, -1, -1, 1, nextPriority(), true};
+
+        int left, right;
+        split(root, player, left, right);
+        root = merge(merge(left, player), right);
+    }
+
+    void erase(int player) {
+        if (!contains(player)) return;
+        root = eraseNode(root, player);
+        nodes[player].present = false;
+    }
+
+    void clear() {
+        nodes.clear();
+        root = -1;
+    }
+
+    // Player at 0-based position rank, or -1
+    int playerAt(int rank) const {
+        int node = root;
+        while (node >= 0) {
+            int leftSize = sizeOf(nodes[node].left);
+            if (rank < leftSize) {
+                node = nodes[node].left;
+            } else if (rank == leftSize) {
+                return node;
+            } else {
+                rank -= leftSize + 1;
+                node = nodes[node].right;
             }
-            temp = temp->next;
         }
+        return -1;
+    }
 
-        if (!found) {
-            cout << "No match found with ID " << matchID << "!" << endl;
+    // 1-based rank of the player, or 0 if they are not on this leaderboard
+    int rankOf(int player) const {
+        if (!contains(player)) return 0;
+        int rank = 0;
+        int node = root;
+        while (node != player) {
+            if (ahead(player, node)) {
+                node = nodes[node].left;
+            } else {
+                rank += sizeOf(nodes[node].left) + 1;
+                node = nodes[node].right;
+            }
         }
+        return rank + sizeOf(nodes[player].left) + 1;
     }
 
-    // Export match history to a CSV file
-    void exportMatchHistory() {
-        ofstream file("match_history_export.csv");
-        if (!file) {
-            cout << "Error opening file for export!" << endl;
+    double scoreOf(int player) const {
+        return nodes[player].score;
+    }
+};
+
+// Running totals over a group of matches (one stage, one day, ...). Every player's
+// score in a match counts as one sample for min/max/mean/variance; the variance
+// uses Welford's online update so it never needs a second pass.
+struct ScoreAggregate {
+    long long matches;
+    long long pointSum;
+    long long samples;
+    int minScore;
+    int maxScore;
+    double mean;
+    double m2;          // Sum of squared differences from the mean
+
+    ScoreAggregate() : matches(0), pointSum(0), samples(0), minScore(INT_MAX), maxScore(INT_MIN), mean(0.0), m2(0.0) {}
+
+    void addScore(int score) {
+        samples++;
+        minScore = min(minScore, score);
+        maxScore = max(maxScore, score);
+        double delta = score - mean;
+        mean += delta / samples;
+        m2 += delta * (score - mean);
+    }
+
+    void addMatch(int score1, int score2) {
+        matches++;
+        pointSum += score1 + score2;
+        addScore(score1);
+        addScore(score2);
+    }
+
+    // Combine with the totals of a disjoint group of matches
+    void merge(const ScoreAggregate& other) {
+        if (other.samples == 0) return;
+        if (samples == 0) {
+            *this = other;
             return;
         }
+        long long total = samples + other.samples;
+        double delta = other.mean - mean;
+        m2 += other.m2 + delta * delta * (static_cast<double>(samples) * other.samples / total);
+        mean += delta * other.samples / total;
+        samples = total;
+        matches += other.matches;
+        pointSum += other.pointSum;
+        minScore = min(minScore, other.minScore);
+        maxScore = max(maxScore, other.maxScore);
+    }
 
-        file << "Match ID,Date,Stage,Player 1,Player 2,Score 1,Score 2,Winner\n";
-        MatchHistory* temp = top;
-        while (temp) {
-            file << temp->matchID << ","
-                 << temp->date << ","
-                 << temp->stage << ","
-                 << temp->player1 << ","
-                 << temp->player2 << ","
-                 << temp->score1 << ","
-                 << temp->score2 << ","
-                 << temp->winner << "\n";
-            temp = temp->next;
-        }
-        file.close();
-        cout << "Match history exported to match_history_export.csv" << endl;
+    double variance() const {
+        return samples > 1 ? m2 / (samples - 1) : 0.0;
     }
 
-    // Display player statistics
-    void displayPlayerStats() {
-        if (!statsHead) {
-            cout << "No player statistics available." << endl;
-            return;
+    double averagePointsPerMatch() const {
+        return matches > 0 ? static_cast<double>(pointSum) / matches : 0.0;
+    }
+};
+
+enum LeaderboardMetric { LB_WINS, LB_WIN_RATE, LB_POINTS, LB_RATING, LB_COUNT };
+
+const char* const LEADERBOARD_NAMES[LB_COUNT] = {"Most Wins", "Win Rate (min 3 matches)", "Total Points", "Rating"};
+
+// Entry index of a name table stored at tableOffset: uint32 offsets[count + 1]
+// followed by the characters of every name
+inline string_view nameTableEntry(const char* data, uint64_t tableOffset, uint32_t count, int32_t index) {
+    if (index < 0 || static_cast<uint32_t>(index) >= count) {
+        return string_view();
+    }
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(data + tableOffset);
+    const char* chars = reinterpret_cast<const char*>(offsets + count + 1);
+    return string_view(chars + offsets[index], offsets[index + 1] - offsets[index]);
+}
+
+// Check a name table read from a mapped file: it must lie inside the file and its
+// offsets must be in order, so nameTableEntry never reads outside the mapping
+inline bool validNameTable(const char* data, uint64_t fileSize, uint64_t tableOffset, uint32_t count) {
+    uint64_t offsetBytes = (static_cast<uint64_t>(count) + 1) * sizeof(uint32_t);
+    if (tableOffset % sizeof(uint32_t) != 0 || !fitsInFile(tableOffset, offsetBytes, fileSize)) {
+        return false;
+    }
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(data + tableOffset);
+    for (uint32_t i = 0; i < count; i++) {
+        if (offsets[i + 1] < offsets[i]) {
+            return false;
         }
+    }
+    return fitsInFile(tableOffset + offsetBytes, offsets[count], fileSize);
+}
+
+// Binary match history file (match_history.bin). Every field is stored as its own
+// fixed-width column so the file can be memory-mapped and queried in place:
+//
+//   ArchiveHeader
+//   int32  matchID[rows]   (ascending)
+//   int32  player1[rows]   (index into the player name table)
+//   int32  player2[rows]
+//   int32  score1[rows]
+//   int32  score2[rows]
+//   int32  winner[rows]    (index into the player name table)
+//   int32  stage[rows]     (index into the stage name table)
+//   int32  epochDay[rows]
+//   player name table, stage name table: uint32 offsets[count + 1] followed by the characters
+struct ArchiveHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t rowCount;
+    uint32_t playerCount;
+    uint32_t stageCount;
+    int32_t minMatchID;
+    int32_t maxMatchID;
+    uint64_t columnOffset[8];
+    uint64_t playerTableOffset;
+    uint64_t stageTableOffset;
+    uint64_t fileSize;
+};
 
-        cout << "\n===== PLAYER STATISTICS =====\n";
-        cout << "+----------------+----------------+----------------+----------------------+---------------+\n";
-        cout << "|   Player Name  | Matches Played |  Matches Won   | Total Points Scored  |   Win Rate    |\n";
-        cout << "+----------------+----------------+----------------+----------------------+---------------+\n";
+const char ARCHIVE_MAGIC[8] = {'A', 'P', 'U', 'M', 'H', 'B', 'I', 'N'};
+const uint32_t ARCHIVE_VERSION = 1;
 
-        PlayerStats* temp = statsHead;
-        while (temp) {
-            cout << "| " << setw(14) << temp->playerName << " | "
-                 << setw(14) << temp->matchesPlayed << " | "
-                 << setw(14) << temp->matchesWon << " | "
-                 << setw(20) << temp->totalPointsScored << " | "
-                 << setw(11) << fixed << setprecision(2) << temp->winRate * 100 << "% |\n";
-            temp = temp->next;
+enum ArchiveColumn { COL_ID, COL_PLAYER1, COL_PLAYER2, COL_SCORE1, COL_SCORE2, COL_WINNER, COL_STAGE, COL_DAY };
+
+// Read-only view of a memory-mapped match_history.bin
+class MatchArchive {
+private:
+    MappedFile file;
+    const char* data;
+    const ArchiveHeader* header;
+    const int32_t* columns[8];
+    // Date index, built on the first date query: rows are either already in date
+    // order (the normal case, matches are archived in ID order) or listed in rowsByDay
+    mutable bool dayIndexReady;
+    mutable bool daysSorted;
+    mutable vector<uint32_t> rowsByDay;
+
+public:
+    MatchArchive() : data(nullptr), header(nullptr), dayIndexReady(false), daysSorted(true) {
+        for (auto& column : columns) column = nullptr;
+    }
+
+    MatchArchive(const MatchArchive&) = delete;
+    MatchArchive& operator=(const MatchArchive&) = delete;
+
+    // Map the file; returns false if it does not exist or is not a valid archive
+    bool open(const string& filename) {
+        close();
+        if (!file.open(filename, sizeof(ArchiveHeader))) {
+            return false;
+        }
+        data = file.data();
+        header = reinterpret_cast<const ArchiveHeader*>(data);
+        bool valid = memcmp(header->magic, ARCHIVE_MAGIC, 8) == 0 &&
+                     header->version == ARCHIVE_VERSION && header->fileSize == file.size() && sectionsFit();
+        if (valid) {
+            for (int c = 0; c < 8; c++) {
+                columns[c] = reinterpret_cast<const int32_t*>(data + header->columnOffset[c]);
+            }
+            valid = codesFit();
+        }
+        if (!valid) {
+            LockedOutput out; // Shards are loaded on several threads at once
+            out << "Ignoring invalid binary match archive " << filename << "." << endl;
+            close();
+            return false;
         }
-        cout << "+----------------+----------------+----------------+----------------------+---------------+\n";
+        return true;
     }
 
-    // Find top performers
-    void displayTopPerformers() {
-        if (!statsHead) {
-            cout << "No player statistics available." << endl;
-            return;
+    void close() {
+        file.close();
+        data = nullptr;
+        header = nullptr;
+        for (auto& column : columns) column = nullptr;
+        dayIndexReady = false;
+        daysSorted = true;
+        rowsByDay.clear();
+    }
+
+    size_t fileSize() const { return file.size(); }
+    bool isOpen() const { return header != nullptr; }
+    size_t size() const { return header ? header->rowCount : 0; }
+    int minMatchID() const { return header && header->rowCount ? header->minMatchID : 0; }
+    int maxMatchID() const { return header && header->rowCount ? header->maxMatchID : 0; }
+    uint32_t playerCount() const { return header ? header->playerCount : 0; }
+    uint32_t stageCount() const { return header ? header->stageCount : 0; }
+
+    int32_t value(ArchiveColumn column, size_t row) const { return columns[column][row]; }
+    const int32_t* column(ArchiveColumn column) const { return columns[column]; }
+
+    string_view playerName(int32_t index) const {
+        return nameTableEntry(data, header->playerTableOffset, header->playerCount, index);
+    }
+
+    string_view stageName(int32_t index) const {
+        return nameTableEntry(data, header->stageTableOffset, header->stageCount, index);
+    }
+
+    // Row holding matchID, or -1. IDs are sorted, and usually dense so the row is found directly.
+    long findRow(int matchID) const {
+        size_t rows = size();
+        if (rows == 0 || matchID < header->minMatchID || matchID > header->maxMatchID) {
+            return -1;
         }
+        const int32_t* ids = columns[COL_ID];
+        size_t guess = static_cast<size_t>(matchID - header->minMatchID);
+        if (guess < rows && ids[guess] == matchID) {
+            return static_cast<long>(guess);
+        }
+        const int32_t* found = lower_bound(ids, ids + rows, matchID);
+        return (found != ids + rows && *found == matchID) ? found - ids : -1;
+    }
 
-        // Find player with most wins
-        PlayerStats* mostWins = statsHead;
-        PlayerStats* highestWinRate = statsHead;
-        PlayerStats* highestScorer = statsHead;
+    // Call visit(row) for every row dated between firstDay and lastDay, in date order
+    template <typename Visitor>
+    void visitDayRange(int32_t firstDay, int32_t lastDay, Visitor visit) const {
+        size_t rows = size();
+        if (rows == 0) return;
+        const int32_t* days = columns[COL_DAY];
+
+        if (!dayIndexReady) {
+            daysSorted = is_sorted(days, days + rows);
+            if (!daysSorted) {
+                rowsByDay.resize(rows);
+                for (size_t row = 0; row < rows; row++) rowsByDay[row] = static_cast<uint32_t>(row);
+                stable_sort(rowsByDay.begin(), rowsByDay.end(), [days](uint32_t a, uint32_t b) {
+                    return days[a] < days[b];
+                });
+            }
+            dayIndexReady = true;
+        }
 
-        PlayerStats* temp = statsHead->next;
-        while (temp) {
-            if (temp->matchesWon > mostWins->matchesWon) {
-                mostWins = temp;
+        if (daysSorted) {
+            size_t row = lower_bound(days, days + rows, firstDay) - days;
+            for (; row < rows && days[row] <= lastDay; row++) {
+                visit(row);
             }
-            if (temp->winRate > highestWinRate->winRate && temp->matchesPlayed >= 3) {
-                highestWinRate = temp;
+        } else {
+            auto it = lower_bound(rowsByDay.begin(), rowsByDay.end(), firstDay,
+                                  [days](uint32_t row, int32_t day) { return days[row] < day; });
+            for (; it != rowsByDay.end() && days[*it] <= lastDay; ++it) {
+                visit(*it);
             }
-            if (temp->totalPointsScored > highestScorer->totalPointsScored) {
-                highestScorer = temp;
+        }
+    }
+
+    // Decode one row into a MatchHistory record
+    MatchHistory readRow(size_t row) const {
+        return MatchHistory(columns[COL_ID][row],
+                            string(playerName(columns[COL_PLAYER1][row])),
+                            string(playerName(columns[COL_PLAYER2][row])),
+                            columns[COL_SCORE1][row],
+                            columns[COL_SCORE2][row],
+                            string(playerName(columns[COL_WINNER][row])),
+                            string(stageName(columns[COL_STAGE][row])),
+                            columns[COL_DAY][row]);
+    }
+
+private:
+    // Every column and both name tables must lie inside the mapped file
+    bool sectionsFit() const {
+        uint64_t columnBytes = static_cast<uint64_t>(header->rowCount) * sizeof(int32_t);
+        for (int c = 0; c < 8; c++) {
+            if (header->columnOffset[c] % sizeof(int32_t) != 0 ||
+                !fitsInFile(header->columnOffset[c], columnBytes, file.size())) {
+                return false;
             }
-            temp = temp->next;
         }
+        return validNameTable(data, file.size(), header->playerTableOffset, header->playerCount) &&
+               validNameTable(data, file.size(), header->stageTableOffset, header->stageCount);
+    }
+
+    // Every name code must refer to an entry of its name table, so callers can
+    // index by them directly (segments check the same in decodeBlock)
+    bool codesFit() const {
+        const ArchiveColumn playerColumns[] = {COL_PLAYER1, COL_PLAYER2, COL_WINNER};
+        for (ArchiveColumn column : playerColumns) {
+            for (size_t row = 0; row < header->rowCount; row++) {
+                if (static_cast<uint32_t>(columns[column][row]) >= header->playerCount) return false;
+            }
+        }
+        for (size_t row = 0; row < header->rowCount; row++) {
+            if (static_cast<uint32_t>(columns[COL_STAGE][row]) >= header->stageCount) return false;
+        }
+        return true;
+    }
+};
+
+// Assigns consecutive codes to names and writes them out as a name table
+class NameDictionary {
+private:
+    unordered_map<string, int32_t> codes;
+    vector<string> names;
 
-        cout << "\n===== TOP PERFORMERS =====\n";
-        cout << "Player with most wins: " << mostWins->playerName
-             << " (" << mostWins->matchesWon << " wins)\n";
+public:
+    int32_t intern(string_view name) {
+        string key(name);
+        auto it = codes.find(key);
+        if (it != codes.end()) {
+            return it->second;
+        }
+        int32_t code = static_cast<int32_t>(names.size());
+        codes.emplace(key, code);
+        names.push_back(key);
+        return code;
+    }
 
-        cout << "Player with highest win rate (min 3 matches): " << highestWinRate->playerName
-             << " (" << fixed << setprecision(2) << highestWinRate->winRate * 100 << "%)\n";
+    uint32_t size() const { return static_cast<uint32_t>(names.size()); }
 
-        cout << "Player with highest total score: " << highestScorer->playerName
-             << " (" << highestScorer->totalPointsScored << " points)\n";
+    uint64_t byteSize() const {
+        uint64_t total = (names.size() + 1) * sizeof(uint32_t);
+        for (const string& name : names) total += name.size();
+        return total;
     }
 
-    // Generate tournament summary
-    void generateTournamentSummary() {
-        if (!top) {
-            cout << "No match data available for summary." << endl;
-            return;
+    void write(ofstream& file) const {
+        vector<uint32_t> offsets(names.size() + 1, 0);
+        for (size_t i = 0; i < names.size(); i++) {
+            offsets[i + 1] = offsets[i] + static_cast<uint32_t>(names[i].size());
         }
+        file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        for (const string& name : names) {
+            file.write(name.data(), name.size());
+        }
+    }
+};
 
-        int totalMatches = 0;
-        int totalPoints = 0;
-        double avgPointsPerMatch = 0.0;
-        map<string, int> stageMatches;
+inline uint64_t alignTo8(uint64_t offset) {
+    return (offset + 7) & ~static_cast<uint64_t>(7);
+}
 
-        MatchHistory* temp = top;
-        while (temp) {
-            totalMatches++;
-            totalPoints += (temp->score1 + temp->score2);
-            stageMatches[temp->stage]++;
-            temp = temp->next;
+// Pad file with zeros up to target, the start of its next section
+inline void padFileTo(ofstream& file, uint64_t target) {
+    static const char zeros[8] = {0};
+    uint64_t position = static_cast<uint64_t>(file.tellp());
+    if (target > position) file.write(zeros, target - position);
+}
+
+// Collects rows in match ID order and writes them out as a match_history.bin file
+class MatchArchiveWriter {
+private:
+    vector<int32_t> columns[8];
+    NameDictionary players;
+    NameDictionary stages;
+
+public:
+    size_t size() const { return columns[COL_ID].size(); }
+
+    void reserve(size_t rows) {
+        for (auto& column : columns) column.reserve(rows);
+    }
+
+    // Rows must be added in increasing match ID order
+    void addRow(int matchID, string_view player1, string_view player2, int score1, int score2,
+                string_view winner, string_view stage, int32_t epochDay) {
+        columns[COL_ID].push_back(matchID);
+        columns[COL_PLAYER1].push_back(players.intern(player1));
+        columns[COL_PLAYER2].push_back(players.intern(player2));
+        columns[COL_SCORE1].push_back(score1);
+        columns[COL_SCORE2].push_back(score2);
+        columns[COL_WINNER].push_back(players.intern(winner));
+        columns[COL_STAGE].push_back(stages.intern(stage));
+        columns[COL_DAY].push_back(epochDay);
+    }
+
+    void addRow(const MatchArchive& archive, size_t row) {
+        addRow(archive.value(COL_ID, row),
+               archive.playerName(archive.value(COL_PLAYER1, row)),
+               archive.playerName(archive.value(COL_PLAYER2, row)),
+               archive.value(COL_SCORE1, row),
+               archive.value(COL_SCORE2, row),
+               archive.playerName(archive.value(COL_WINNER, row)),
+               archive.stageName(archive.value(COL_STAGE, row)),
+               archive.value(COL_DAY, row));
+    }
+
+    void addRow(const MatchHistory* match) {
+        addRow(match->matchID, match->player1, match->player2, match->score1, match->score2,
+               match->winner, match->stage, match->epochDay);
+    }
+
+    bool save(const string& filename) {
+        ArchiveHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, ARCHIVE_MAGIC, 8);
+        header.version = ARCHIVE_VERSION;
+        header.rowCount = static_cast<uint32_t>(size());
+        header.playerCount = players.size();
+        header.stageCount = stages.size();
+        header.minMatchID = size() ? columns[COL_ID].front() : 0;
+        header.maxMatchID = size() ? columns[COL_ID].back() : 0;
+
+        uint64_t offset = alignTo8(sizeof(ArchiveHeader));
+        for (int c = 0; c < 8; c++) {
+            header.columnOffset[c] = offset;
+            offset = alignTo8(offset + size() * sizeof(int32_t));
+        }
+        header.playerTableOffset = offset;
+        offset = alignTo8(offset + players.byteSize());
+        header.stageTableOffset = offset;
+        offset = alignTo8(offset + stages.byteSize());
+        header.fileSize = offset;
+
+        ofstream file(filename, ios::binary | ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (int c = 0; c < 8; c++) {
+            padFileTo(file, header.columnOffset[c]);
+            file.write(reinterpret_cast<const char*>(columns[c].data()), columns[c].size() * sizeof(int32_t));
+        }
+        padFileTo(file, header.playerTableOffset);
+        players.write(file);
+        padFileTo(file, header.stageTableOffset);
+        stages.write(file);
+        padFileTo(file, header.fileSize);
+        return static_cast<bool>(file);
+    }
+};
+
+// Compressed segment file (match_segment_<n>.seg) holding sealed older history.
+// A segment is written once and never changed. Rows are cut into blocks, and every
+// block is stored column by column as LEB128 varints:
+//
+//   SegmentHeader
+//   block data
+//     matchID            zigzag first ID, then the gap to the previous ID
+//     player1, player2   player name codes
+//     score1, score2     zigzag
+//     winner             0 = player 1, 1 = player 2, otherwise player code + 2
+//     stage              stage name code
+//     epochDay           zigzag first day, then the zigzag change from the previous row
+//   SegmentBlockInfo[blockCount]   block index: ID and date range of every block
+//   player name table, stage name table (same layout as match_history.bin)
+//
+// Queries look at the block index first and only decode the blocks they need.
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t rowCount;
+    uint32_t blockCount;
+    uint32_t playerCount;
+    uint32_t stageCount;
+    int32_t minMatchID;
+    int32_t maxMatchID;
+    int32_t minDay;
+    int32_t maxDay;
+    uint32_t reserved;
+    uint64_t blockIndexOffset;
+    uint64_t playerTableOffset;
+    uint64_t stageTableOffset;
+    uint64_t fileSize;
+};
+
+struct SegmentBlockInfo {
+    int32_t firstMatchID;
+    int32_t lastMatchID;
+    int32_t minDay;
+    int32_t maxDay;
+    uint32_t rowCount;
+    uint32_t byteSize;
+    uint64_t offset;
+};
+
+const char SEGMENT_MAGIC[8] = {'A', 'P', 'U', 'M', 'H', 'S', 'E', 'G'};
+const uint32_t SEGMENT_VERSION = 1;
+const uint32_t SEGMENT_BLOCK_ROWS = 1024;
+const uint32_t SEGMENT_MAX_ROWS = 64 * SEGMENT_BLOCK_ROWS; // Spills stop growing a segment past this
+
+inline uint32_t zigzagEncode(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t value) {
+    return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+inline void putVarint(vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Read one varint from [in, end); returns false if the data runs out first
+inline bool getVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// One decoded block: player, winner and stage columns hold name codes, like the archive
+struct SegmentBlock {
+    size_t rows;
+    vector<int32_t> columns[8];
+
+    SegmentBlock() : rows(0) {}
+};
+
+// Read-only view of one memory-mapped segment file
+class MatchSegment {
+private:
+    MappedFile file;
+    const SegmentHeader* header;
+    const SegmentBlockInfo* blocks;
+
+public:
+    MatchSegment() : header(nullptr), blocks(nullptr) {}
+
+    MatchSegment(const MatchSegment&) = delete;
+    MatchSegment& operator=(const MatchSegment&) = delete;
+
+    bool open(const string& filename) {
+        header = nullptr;
+        blocks = nullptr;
+        if (!file.open(filename, sizeof(SegmentHeader))) {
+            return false;
+        }
+        const SegmentHeader* candidate = reinterpret_cast<const SegmentHeader*>(file.data());
+        if (memcmp(candidate->magic, SEGMENT_MAGIC, 8) != 0 || candidate->version != SEGMENT_VERSION ||
+            candidate->fileSize != file.size() || !sectionsFit(candidate)) {
+            LockedOutput out;
+            out << "Ignoring invalid match segment " << filename << "." << endl;
+            file.close();
+            return false;
+        }
+        header = candidate;
+        blocks = reinterpret_cast<const SegmentBlockInfo*>(file.data() + header->blockIndexOffset);
+        return true;
+    }
+
+    size_t size() const { return header->rowCount; }
+    size_t fileSize() const { return file.size(); }
+    size_t blockCount() const { return header->blockCount; }
+    const SegmentBlockInfo& blockInfo(size_t block) const { return blocks[block]; }
+    int minMatchID() const { return header->minMatchID; }
+    int maxMatchID() const { return header->maxMatchID; }
+    uint32_t playerCount() const { return header->playerCount; }
+    uint32_t stageCount() const { return header->stageCount; }
+
+    string_view playerName(int32_t index) const {
+        return nameTableEntry(file.data(), header->playerTableOffset, header->playerCount, index);
+    }
+
+    string_view stageName(int32_t index) const {
+        return nameTableEntry(file.data(), header->stageTableOffset, header->stageCount, index);
+    }
+
+    // Block that would hold matchID, or -1 if it is outside every block's ID range
+    long findBlock(int matchID) const {
+        const SegmentBlockInfo* last = blocks + header->blockCount;
+        const SegmentBlockInfo* found = lower_bound(blocks, last, matchID,
+            [](const SegmentBlockInfo& info, int id) { return info.lastMatchID < id; });
+        return (found != last && found->firstMatchID <= matchID) ? found - blocks : -1;
+    }
+
+    // Decode every column of one block into out
+    bool decodeBlock(size_t block, SegmentBlock& out) const {
+        const SegmentBlockInfo& info = blocks[block];
+        const uint8_t* in = reinterpret_cast<const uint8_t*>(file.data() + info.offset);
+        const uint8_t* end = in + info.byteSize;
+        size_t rows = info.rowCount;
+        for (auto& column : out.columns) column.resize(rows);
+        out.rows = 0;
+
+        uint32_t value;
+        int32_t previous = 0;
+        for (size_t row = 0; row < rows; row++) {
+            if (!getVarint(in, end, value)) return false;
+            previous = (row == 0) ? zigzagDecode(value) : previous + static_cast<int32_t>(value);
+            out.columns[COL_ID][row] = previous;
+        }
+        // Name codes are checked here so callers can index by them directly
+        const ArchiveColumn plainColumns[] = {COL_PLAYER1, COL_PLAYER2};
+        for (ArchiveColumn column : plainColumns) {
+            for (size_t row = 0; row < rows; row++) {
+                if (!getVarint(in, end, value) || value >= header->playerCount) return false;
+                out.columns[column][row] = static_cast<int32_t>(value);
+            }
+        }
+        const ArchiveColumn scoreColumns[] = {COL_SCORE1, COL_SCORE2};
+        for (ArchiveColumn column : scoreColumns) {
+            for (size_t row = 0; row < rows; row++) {
+                if (!getVarint(in, end, value)) return false;
+                out.columns[column][row] = zigzagDecode(value);
+            }
+        }
+        for (size_t row = 0; row < rows; row++) {
+            if (!getVarint(in, end, value) || (value > 1 && value - 2 >= header->playerCount)) return false;
+            out.columns[COL_WINNER][row] = (value == 0) ? out.columns[COL_PLAYER1][row]
+                                         : (value == 1) ? out.columns[COL_PLAYER2][row]
+                                         : static_cast<int32_t>(value - 2);
+        }
+        for (size_t row = 0; row < rows; row++) {
+            if (!getVarint(in, end, value) || value >= header->stageCount) return false;
+            out.columns[COL_STAGE][row] = static_cast<int32_t>(value);
+        }
+        previous = 0;
+        for (size_t row = 0; row < rows; row++) {
+            if (!getVarint(in, end, value)) return false;
+            previous = (row == 0) ? zigzagDecode(value) : previous + zigzagDecode(value);
+            out.columns[COL_DAY][row] = previous;
+        }
+        out.rows = rows;
+        return true;
+    }
+
+    MatchHistory readRow(const SegmentBlock& block, size_t row) const {
+        return MatchHistory(block.columns[COL_ID][row],
+                            string(playerName(block.columns[COL_PLAYER1][row])),
+                            string(playerName(block.columns[COL_PLAYER2][row])),
+                            block.columns[COL_SCORE1][row],
+                            block.columns[COL_SCORE2][row],
+                            string(playerName(block.columns[COL_WINNER][row])),
+                            string(stageName(block.columns[COL_STAGE][row])),
+                            block.columns[COL_DAY][row]);
+    }
+
+private:
+    // The block index, every block's data and both name tables must lie inside the
+    // mapped file. Each row takes at least one byte per column, which bounds rowCount.
+    bool sectionsFit(const SegmentHeader* candidate) const {
+        const char* data = file.data();
+        uint64_t size = file.size();
+        uint64_t indexBytes = static_cast<uint64_t>(candidate->blockCount) * sizeof(SegmentBlockInfo);
+        if (candidate->blockIndexOffset % alignof(SegmentBlockInfo) != 0 ||
+            !fitsInFile(candidate->blockIndexOffset, indexBytes, size)) {
+            return false;
+        }
+        const SegmentBlockInfo* index = reinterpret_cast<const SegmentBlockInfo*>(data + candidate->blockIndexOffset);
+        uint64_t rows = 0;
+        for (uint32_t b = 0; b < candidate->blockCount; b++) {
+            if (!fitsInFile(index[b].offset, index[b].byteSize, size) ||
+                static_cast<uint64_t>(index[b].rowCount) * 8 > index[b].byteSize) {
+                return false;
+            }
+            rows += index[b].rowCount;
+        }
+        return rows == candidate->rowCount &&
+               validNameTable(data, size, candidate->playerTableOffset, candidate->playerCount) &&
+               validNameTable(data, size, candidate->stageTableOffset, candidate->stageCount);
+    }
+};
+
+// Encodes rows, added in increasing match ID order, into a new segment file
+class MatchSegmentWriter {
+private:
+    NameDictionary players;
+    NameDictionary stages;
+    vector<int32_t> pending[8];        // Rows of the block being filled
+    vector<uint8_t> encoded;           // Finished blocks
+    vector<SegmentBlockInfo> blocks;
+    size_t rowCount;
+
+    void encodeBlock() {
+        size_t rows = pending[COL_ID].size();
+        if (rows == 0) return;
+
+        SegmentBlockInfo info;
+        info.firstMatchID = pending[COL_ID].front();
+        info.lastMatchID = pending[COL_ID].back();
+        info.minDay = *min_element(pending[COL_DAY].begin(), pending[COL_DAY].end());
+        info.maxDay = *max_element(pending[COL_DAY].begin(), pending[COL_DAY].end());
+        info.rowCount = static_cast<uint32_t>(rows);
+        info.offset = encoded.size(); // Relative to the block data for now
+        size_t start = encoded.size();
+
+        for (size_t row = 0; row < rows; row++) {
+            putVarint(encoded, row == 0 ? zigzagEncode(pending[COL_ID][0])
+                                        : static_cast<uint32_t>(pending[COL_ID][row] - pending[COL_ID][row - 1]));
+        }
+        for (int32_t code : pending[COL_PLAYER1]) putVarint(encoded, static_cast<uint32_t>(code));
+        for (int32_t code : pending[COL_PLAYER2]) putVarint(encoded, static_cast<uint32_t>(code));
+        for (int32_t score : pending[COL_SCORE1]) putVarint(encoded, zigzagEncode(score));
+        for (int32_t score : pending[COL_SCORE2]) putVarint(encoded, zigzagEncode(score));
+        for (size_t row = 0; row < rows; row++) {
+            int32_t winner = pending[COL_WINNER][row];
+            putVarint(encoded, winner == pending[COL_PLAYER1][row] ? 0
+                             : winner == pending[COL_PLAYER2][row] ? 1
+                             : static_cast<uint32_t>(winner) + 2);
+        }
+        for (int32_t code : pending[COL_STAGE]) putVarint(encoded, static_cast<uint32_t>(code));
+        for (size_t row = 0; row < rows; row++) {
+            putVarint(encoded, zigzagEncode(row == 0 ? pending[COL_DAY][0]
+                                                     : pending[COL_DAY][row] - pending[COL_DAY][row - 1]));
+        }
+
+        info.byteSize = static_cast<uint32_t>(encoded.size() - start);
+        blocks.push_back(info);
+        for (auto& column : pending) column.clear();
+    }
+
+public:
+    MatchSegmentWriter() : rowCount(0) {}
+
+    size_t size() const { return rowCount; }
+
+    void addRow(int matchID, string_view player1, string_view player2, int score1, int score2,
+                string_view winner, string_view stage, int32_t epochDay) {
+        pending[COL_ID].push_back(matchID);
+        pending[COL_PLAYER1].push_back(players.intern(player1));
+        pending[COL_PLAYER2].push_back(players.intern(player2));
+        pending[COL_SCORE1].push_back(score1);
+        pending[COL_SCORE2].push_back(score2);
+        pending[COL_WINNER].push_back(players.intern(winner));
+        pending[COL_STAGE].push_back(stages.intern(stage));
+        pending[COL_DAY].push_back(epochDay);
+        rowCount++;
+        if (pending[COL_ID].size() == SEGMENT_BLOCK_ROWS) {
+            encodeBlock();
+        }
+    }
+
+    void addRow(const MatchArchive& archive, size_t row) {
+        addRow(archive.value(COL_ID, row),
+               archive.playerName(archive.value(COL_PLAYER1, row)),
+               archive.playerName(archive.value(COL_PLAYER2, row)),
+               archive.value(COL_SCORE1, row),
+               archive.value(COL_SCORE2, row),
+               archive.playerName(archive.value(COL_WINNER, row)),
+               archive.stageName(archive.value(COL_STAGE, row)),
+               archive.value(COL_DAY, row));
+    }
+
+    void addRow(const MatchHistory* match) {
+        addRow(match->matchID, match->player1, match->player2, match->score1, match->score2,
+               match->winner, match->stage, match->epochDay);
+    }
+
+    void addRow(const MatchSegment& segment, const SegmentBlock& block, size_t row) {
+        addRow(block.columns[COL_ID][row],
+               segment.playerName(block.columns[COL_PLAYER1][row]),
+               segment.playerName(block.columns[COL_PLAYER2][row]),
+               block.columns[COL_SCORE1][row],
+               block.columns[COL_SCORE2][row],
+               segment.playerName(block.columns[COL_WINNER][row]),
+               segment.stageName(block.columns[COL_STAGE][row]),
+               block.columns[COL_DAY][row]);
+    }
+
+    // Copy every row of segment; false if one of its blocks cannot be decoded
+    bool addRows(const MatchSegment& segment) {
+        SegmentBlock block;
+        for (size_t b = 0; b < segment.blockCount(); b++) {
+            if (!segment.decodeBlock(b, block)) return false;
+            for (size_t row = 0; row < block.rows; row++) addRow(segment, block, row);
+        }
+        return true;
+    }
+
+    bool save(const string& filename) {
+        encodeBlock();
+
+        SegmentHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SEGMENT_MAGIC, 8);
+        header.version = SEGMENT_VERSION;
+        header.rowCount = static_cast<uint32_t>(rowCount);
+        header.blockCount = static_cast<uint32_t>(blocks.size());
+        header.playerCount = players.size();
+        header.stageCount = stages.size();
+        header.minMatchID = blocks.empty() ? 0 : blocks.front().firstMatchID;
+        header.maxMatchID = blocks.empty() ? 0 : blocks.back().lastMatchID;
+        header.minDay = INT32_MAX;
+        header.maxDay = INT32_MIN;
+        for (const SegmentBlockInfo& info : blocks) {
+            header.minDay = min(header.minDay, info.minDay);
+            header.maxDay = max(header.maxDay, info.maxDay);
+        }
+
+        uint64_t dataOffset = sizeof(SegmentHeader);
+        for (SegmentBlockInfo& info : blocks) {
+            info.offset += dataOffset;
+        }
+        header.blockIndexOffset = alignTo8(dataOffset + encoded.size());
+        header.playerTableOffset = alignTo8(header.blockIndexOffset + blocks.size() * sizeof(SegmentBlockInfo));
+        header.stageTableOffset = alignTo8(header.playerTableOffset + players.byteSize());
+        header.fileSize = alignTo8(header.stageTableOffset + stages.byteSize());
+
+        ofstream file(filename, ios::binary | ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        padFileTo(file, header.blockIndexOffset);
+        file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(SegmentBlockInfo));
+        padFileTo(file, header.playerTableOffset);
+        players.write(file);
+        padFileTo(file, header.stageTableOffset);
+        stages.write(file);
+        padFileTo(file, header.fileSize);
+        return static_cast<bool>(file);
+    }
+};
+
+// Every segment on disk, oldest first. Segment n is match_segment_<n>.seg; each one
+// holds higher match IDs than the one before it.
+class MatchSegmentStore {
+private:
+    vector<unique_ptr<MatchSegment>> segments;
+    string prefix;
+    int nextNumber;
+
+    string segmentFilename(int number) const {
+        return segmentFilename(prefix, number);
+    }
+
+    static string segmentFilename(const string& filePrefix, int number) {
+        return filePrefix + "_" + to_string(number) + ".seg";
+    }
+
+public:
+    MatchSegmentStore() : nextNumber(1) {}
+
+    // Names of the segment files under filePrefix that exist on disk
+    static vector<string> existingFiles(const string& filePrefix) {
+        vector<string> files;
+        for (int number = 1; ifstream(segmentFilename(filePrefix, number)); number++) {
+            files.push_back(segmentFilename(filePrefix, number));
+        }
+        return files;
+    }
+
+    // Open prefix_1.seg, prefix_2.seg, ... up to the first missing number
+    void open(const string& filePrefix) {
+        prefix = filePrefix;
+        segments.clear();
+        for (nextNumber = 1; ; nextNumber++) {
+            unique_ptr<MatchSegment> segment(new MatchSegment());
+            if (!segment->open(segmentFilename(nextNumber))) {
+                break;
+            }
+            segments.push_back(move(segment));
+        }
+    }
+
+    // Write writer's rows out as the next segment and open it. With replaceNewest,
+    // the rows (which must include all of the newest segment's) take its place instead.
+    bool add(MatchSegmentWriter& writer, string& filename, bool replaceNewest = false) {
+        replaceNewest = replaceNewest && !segments.empty();
+        filename = segmentFilename(replaceNewest ? nextNumber - 1 : nextNumber);
+        string tempName = filename + ".tmp";
+        if (!writer.save(tempName)) {
+            return false;
+        }
+#ifdef _WIN32
+        if (replaceNewest) remove(filename.c_str()); // rename() does not overwrite on Windows
+#endif
+        if (rename(tempName.c_str(), filename.c_str()) != 0) {
+            return false;
+        }
+        unique_ptr<MatchSegment> segment(new MatchSegment());
+        if (!segment->open(filename)) {
+            return false;
+        }
+        if (replaceNewest) {
+            segments.back() = move(segment);
+        } else {
+            segments.push_back(move(segment));
+            nextNumber++;
+        }
+        return true;
+    }
+
+    size_t segmentCount() const { return segments.size(); }
+    const MatchSegment& segment(size_t index) const { return *segments[index]; }
+
+    size_t size() const {
+        size_t rows = 0;
+        for (const auto& segment : segments) rows += segment->size();
+        return rows;
+    }
+
+    size_t fileSize() const {
+        size_t bytes = 0;
+        for (const auto& segment : segments) bytes += segment->fileSize();
+        return bytes;
+    }
+
+    int maxMatchID() const {
+        return segments.empty() ? 0 : segments.back()->maxMatchID();
+    }
+
+    // Decode the one block that could hold matchID. Segments hold increasing IDs,
+    // so the segment is found by binary search.
+    bool findMatch(int matchID, MatchHistory& match) const {
+        auto it = lower_bound(segments.begin(), segments.end(), matchID,
+            [](const unique_ptr<MatchSegment>& segment, int id) { return segment->maxMatchID() < id; });
+        if (it == segments.end() || matchID < (*it)->minMatchID()) {
+            return false;
+        }
+        const MatchSegment& segment = **it;
+        SegmentBlock block;
+        long index = segment.findBlock(matchID);
+        if (index < 0 || !segment.decodeBlock(index, block)) {
+            return false;
+        }
+        const vector<int32_t>& ids = block.columns[COL_ID];
+        auto found = lower_bound(ids.begin(), ids.end(), matchID);
+        if (found != ids.end() && *found == matchID) {
+            match = segment.readRow(block, found - ids.begin());
+            return true;
+        }
+        return false;
+    }
+
+    // Call visit(segment, block) for every block, oldest or newest first
+    template <typename Visitor>
+    void visitBlocks(Visitor visit, bool newestFirst = false) const {
+        SegmentBlock block;
+        for (size_t s = 0; s < segments.size(); s++) {
+            const MatchSegment& segment = *segments[newestFirst ? segments.size() - 1 - s : s];
+            for (size_t b = 0; b < segment.blockCount(); b++) {
+                if (segment.decodeBlock(newestFirst ? segment.blockCount() - 1 - b : b, block)) {
+                    visit(segment, block);
+                }
+            }
+        }
+    }
+
+    // Call visit(segment, block, row) for every row with an ID in [firstID, lastID], in ID order
+    template <typename Visitor>
+    void visitRange(int firstID, int lastID, Visitor visit) const {
+        SegmentBlock block;
+        for (const auto& segment : segments) {
+            if (lastID < segment->minMatchID() || firstID > segment->maxMatchID()) continue;
+            for (size_t b = 0; b < segment->blockCount(); b++) {
+                const SegmentBlockInfo& info = segment->blockInfo(b);
+                if (info.lastMatchID < firstID) continue;
+                if (info.firstMatchID > lastID) break;
+                if (!segment->decodeBlock(b, block)) continue;
+                for (size_t row = 0; row < block.rows; row++) {
+                    int id = block.columns[COL_ID][row];
+                    if (id >= firstID && id <= lastID) visit(*segment, block, row);
+                }
+            }
+        }
+    }
+
+    // Call visit(segment, block, row) for every row dated between firstDay and lastDay,
+    // in ID order. Blocks whose date range misses the query are skipped undecoded.
+    template <typename Visitor>
+    void visitDays(int32_t firstDay, int32_t lastDay, Visitor visit) const {
+        SegmentBlock block;
+        for (const auto& segment : segments) {
+            for (size_t b = 0; b < segment->blockCount(); b++) {
+                const SegmentBlockInfo& info = segment->blockInfo(b);
+                if (info.maxDay < firstDay || info.minDay > lastDay) continue;
+                if (!segment->decodeBlock(b, block)) continue;
+                for (size_t row = 0; row < block.rows; row++) {
+                    int32_t day = block.columns[COL_DAY][row];
+                    if (day >= firstDay && day <= lastDay) visit(*segment, block, row);
+                }
+            }
+        }
+    }
+
+    // Rows with an ID above matchID; only the block holding matchID is decoded
+    size_t countAbove(int matchID) const {
+        size_t rows = 0;
+        SegmentBlock block;
+        for (const auto& segment : segments) {
+            if (segment->maxMatchID() <= matchID) continue;
+            for (size_t b = 0; b < segment->blockCount(); b++) {
+                const SegmentBlockInfo& info = segment->blockInfo(b);
+                if (info.firstMatchID > matchID) {
+                    rows += info.rowCount;
+                } else if (info.lastMatchID > matchID && segment->decodeBlock(b, block)) {
+                    const vector<int32_t>& ids = block.columns[COL_ID];
+                    rows += ids.end() - upper_bound(ids.begin(), ids.end(), matchID);
+                }
+            }
+        }
+        return rows;
+    }
+};
+
+// Streams a text file in large blocks and hands out one line at a time as a
+// string_view into the block buffer, so no memory is allocated per line or field.
+class CsvBlockReader {
+private:
+    static const size_t BLOCK_SIZE = 1 << 20; // 1 MiB reads
+    FILE* file;
+    bool ownsFile;  // False for a stream such as stdin, which is left open
+    vector<char> buffer;
+    size_t begin;   // Start of the unread data in buffer
+    size_t end;     // End of the valid data in buffer
+    bool eof;
+
+    // Move the unread tail to the front of the buffer and read the next block after it
+    void refill() {
+        size_t remaining = end - begin;
+        if (begin > 0 && remaining > 0) {
+            memmove(buffer.data(), buffer.data() + begin, remaining);
+        }
+        begin = 0;
+        end = remaining;
+        if (buffer.size() - end < BLOCK_SIZE) {
+            buffer.resize(end + BLOCK_SIZE); // A single line longer than a block
+        }
+        size_t got = fread(buffer.data() + end, 1, buffer.size() - end, file);
+        end += got;
+        if (got == 0) {
+            eof = true;
+        }
+    }
+
+public:
+    CsvBlockReader(const string& filename)
+        : file(fopen(filename.c_str(), "rb")), ownsFile(true), buffer(BLOCK_SIZE), begin(0), end(0), eof(false) {}
+
+    // Read from a stream that is already open, such as stdin
+    explicit CsvBlockReader(FILE* stream)
+        : file(stream), ownsFile(false), buffer(BLOCK_SIZE), begin(0), end(0), eof(false) {}
+
+    ~CsvBlockReader() {
+        if (file && ownsFile) fclose(file);
+    }
+
+    CsvBlockReader(const CsvBlockReader&) = delete;
+    CsvBlockReader& operator=(const CsvBlockReader&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+
+    // Get the next line without its line ending; the view is valid until the next call
+    bool nextLine(string_view& line) {
+        if (!file) return false;
+        while (true) {
+            const char* start = buffer.data() + begin;
+            const char* newline = static_cast<const char*>(memchr(start, '\n', end - begin));
+            if (newline) {
+                size_t length = newline - start;
+                begin += length + 1;
+                line = string_view(start, length);
+                break;
+            }
+            if (eof) {
+                if (begin == end) return false;
+                line = string_view(start, end - begin); // Last line without a newline
+                begin = end;
+                break;
+            }
+            refill();
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return true;
+    }
+
+    // Split line on commas into at most maxFields views. A trailing empty field is
+    // dropped, the same as reading the tokens with getline(ss, token, ',').
+    static size_t splitFields(string_view line, string_view* fields, size_t maxFields) {
+        size_t count = 0;
+        while (count < maxFields) {
+            size_t comma = line.find(',');
+            if (comma == string_view::npos) {
+                if (!line.empty()) fields[count++] = line;
+                break;
+            }
+            fields[count++] = line.substr(0, comma);
+            line.remove_prefix(comma + 1);
+        }
+        return count;
+    }
+
+    static bool toInt(string_view field, int& value) {
+        const char* first = field.data();
+        const char* last = first + field.size();
+        while (first < last && *first == ' ') first++; // stoi skipped leading spaces too
+        return from_chars(first, last, value).ec == errc();
+    }
+
+    static bool toDouble(string_view field, double& value) {
+        const char* first = field.data();
+        const char* last = first + field.size();
+        while (first < last && *first == ' ') first++;
+        return from_chars(first, last, value).ec == errc();
+    }
+};
+
+// Record between two players. Slot 0 belongs to the player with the lower
+// statistics index, slot 1 to the other one.
+struct HeadToHead {
+    int wins[2];
+    int points[2];
+    int matches;
+    int lastMatchID;
+
+    HeadToHead() : wins{0, 0}, points{0, 0}, matches(0), lastMatchID(0) {}
+};
+
+enum ExportFormat { EXPORT_CSV, EXPORT_NDJSON };
+
+// Read-only copy of the player statistics as of one match. The rows are split into
+// chunks of STATS_VIEW_CHUNK players, and the chunks are grouped into pages of
+// STATS_VIEW_PAGE. A new view only copies the chunks that changed and the pages
+// holding them; everything else is shared with the view before it.
+const size_t STATS_VIEW_CHUNK = 32;
+const size_t STATS_VIEW_PAGE = 64;
+
+struct StatsView {
+    uint64_t version;                 // Increases with every published view
+    int lastMatchID;                  // Newest match included in the statistics
+    size_t playerCount;
+    typedef vector<PlayerStats> Chunk;
+    typedef vector<shared_ptr<const Chunk>> Page;
+    vector<shared_ptr<const Page>> pages;
+    int leaders[LB_COUNT];            // Stats index of the top player per leaderboard, -1 if none
+
+    const PlayerStats& player(size_t index) const {
+        size_t chunk = index / STATS_VIEW_CHUNK;
+        return (*(*pages[chunk / STATS_VIEW_PAGE])[chunk % STATS_VIEW_PAGE])[index % STATS_VIEW_CHUNK];
+    }
+};
+
+// match_history.txt is an append-only log (oldest match first): recording a match
+// appends one line instead of rewriting the whole file. player_stats.txt is a
+// checkpoint of the derived statistics that is rewritten every COMPACTION_INTERVAL
+// matches; its last line "#checkpoint,<id>" tells loadFromFile which logged matches
+// still have to be replayed into the statistics. Both files are written by a
+// background writer thread, so recording a match never waits for the disk.
+// Older history can be sealed into match_history.bin, a memory-mapped columnar
+// file that is queried in place, so startup cost does not grow with its size.
+// The log then only holds matches recorded after the last archive. The oldest tier
+// is a series of compressed, immutable segment files that the archive is sealed into.
+//
+// Every public method may be called from several threads. Recording and all history
+// queries are serialized by trackerMutex. displayPlayerStats and displayTopPerformers
+// instead read the latest published StatsView without taking trackerMutex: the
+// recording thread builds the next view and swaps it in atomically, and an old view
+// is freed once the last reader holding it lets go (read-copy-update through
+// shared_ptr). Every method formats its output into a local buffer and only holds
+// consoleMutex to print it, so spills and log writes never hold up the console.
+class MatchHistoryTracker {
+private:
+    IntrusiveList<MatchHistory> matchStack; // In-memory matches, newest on top
+    PlayerStatsTable stats;
+    RankedLeaderboard leaderboards[LB_COUNT]; // Kept up to date by every stats change
+    ScoreAggregate overallTotals;                  // Running totals over every match,
+    map<string, ScoreAggregate> stageTotals;       // per stage
+    map<int32_t, ScoreAggregate> dayTotals;        // and per day (epoch day)
+    const string MATCH_FILENAME;
+    const string STATS_FILENAME;
+    const string ARCHIVE_FILENAME;
+    const string SEGMENT_PREFIX;
+    const string EXPORT_FILENAMES[2];        // Per ExportFormat
+    const string CHECKPOINT_PREFIX = "#checkpoint,";
+    static const int COMPACTION_INTERVAL = 1000;  // Recorded matches between stats checkpoints
+    static const int MIN_MATCHES_FOR_WIN_RATE = 3;
+    static constexpr double ELO_K_FACTOR = 32.0;
+    int nextMatchID;
+    int recordsSinceCompaction;
+    mutable mutex trackerMutex;              // Held by every public method except the StatsView readers
+    shared_ptr<const StatsView> statsView;   // Only accessed through atomic_load and atomic_store
+
+    // Group commit: recordMatch only queues the log line. The writer thread appends
+    // everything queued with one write once commitRecords lines are waiting or
+    // commitWindow has passed since the first of them, optionally followed by an
+    // fsync. A queued statistics checkpoint is written after the lines before it.
+    // Lines that could not be written stay queued and are retried every
+    // WRITE_RETRY_DELAY; no checkpoint is written until they are in the log.
+    struct PendingCheckpoint {
+        vector<PlayerStats> rows;
+        int lastMatchID;
+    };
+    mutex writerMutex;
+    condition_variable writerWake;     // Work queued, flush or stop requested
+    condition_variable writerIdle;     // Everything queued has been written
+    string pendingLog;                 // Log lines waiting for the writer
+    string writeBuffer;                // Lines being written; swapped with pendingLog
+    int pendingRecords;
+    bool checkpointQueued;
+    PendingCheckpoint checkpoint;
+    bool writerBusy;
+    bool writeFailed;                  // The last commit did not reach the log
+    bool syncPending;                  // Lines were written but their fsync failed
+    bool flushRequested;
+    bool writerStop;
+    int commitRecords;
+    chrono::microseconds commitWindow;
+    bool commitFsync;
+    size_t commitCount;
+    static constexpr chrono::seconds WRITE_RETRY_DELAY{1};
+    FILE* matchLog;                    // Kept open in append mode by the writer
+    thread writerThread;
+    MatchArchive archive;         // Sealed older matches, memory-mapped
+    MatchSegmentStore segments;   // Oldest matches, compressed; all older than the archive
+    // In-memory matches addressed by ID: matchByID[id - idBase], nullptr for holes.
+    // IDs that would leave the table mostly empty go to sparseMatchIDs instead.
+    vector<MatchHistory*> matchByID;
+    int idBase;
+    unordered_map<int, MatchHistory*> sparseMatchIDs;
+    map<int32_t, vector<int>> hotMatchesByDay;  // Epoch day -> IDs of in-memory matches
+    size_t hotMatches;                          // Matches currently held in memory
+    // With hotWindow set, only about that many of the newest matches stay in memory.
+    // Once a further batch has built up, the oldest are spilled into a new segment,
+    // whose block index then serves ID and date lookups for them.
+    size_t hotWindow;                           // 0 keeps every match in memory
+    size_t staleLogLines;                       // Log lines whose matches are already in a segment
+    // Head-to-head records keyed on the unordered pair of statistics indexes, and
+    // for each player the indexes of everyone they have played
+    unordered_map<uint64_t, HeadToHead> headToHead;
+    vector<vector<int>> opponents;
+
+    // Background export. The thread reads the rows gathered in ExportJob and
+    // reports progress through the atomics; exportResult is read after joining it.
+    struct ExportJob {
+        ExportFormat format;
+        string filename;
+        bool append;
+        int watermark;                        // Highest match ID already exported
+        vector<const MatchHistory*> hotRows;  // In-memory rows above the watermark, by ID
+        size_t firstArchiveRow;               // First archive row above the watermark
+        bool includeSegments;                 // Segments hold rows above the watermark
+    };
+    static const size_t EXPORT_BUFFER_SIZE = 1 << 20; // Bytes formatted per write
+    thread exportThread;
+    atomic<bool> exportRunning;
+    atomic<size_t> exportDone;
+    atomic<size_t> exportTotal;
+    chrono::steady_clock::time_point exportStart;
+    string exportResult;
+
+    // Work and partial results of rebuildStatsInParallel
+    struct RebuildChunk {
+        int source;            // Segment number, or the archive or in-memory matches
+        size_t first, last;    // Blocks of a segment, or rows
+    };
+    struct RebuildPartial {
+        PlayerStatsTable players;
+        ScoreAggregate overall;
+        unordered_map<string, ScoreAggregate> stages;
+        unordered_map<int32_t, ScoreAggregate> days;
+    };
+
+public:
+    // With rebuildStats set, player_stats.txt is ignored and the statistics are
+    // recomputed from the match history on several threads. filePrefix is put in
+    // front of every file name.
+    MatchHistoryTracker(bool rebuildStats = false, const string& filePrefix = "")
+        : MATCH_FILENAME(filePrefix + "match_history.txt"),
+          STATS_FILENAME(filePrefix + "player_stats.txt"),
+          ARCHIVE_FILENAME(filePrefix + "match_history.bin"),
+          SEGMENT_PREFIX(filePrefix + "match_segment"),
+          EXPORT_FILENAMES{filePrefix + "match_history_export.csv", filePrefix + "match_history_export.ndjson"},
+          nextMatchID(1), recordsSinceCompaction(0),
+          pendingRecords(0), checkpointQueued(false), writerBusy(false), writeFailed(false), syncPending(false),
+          flushRequested(false),
+          writerStop(false), commitRecords(64), commitWindow(5000), commitFsync(false),
+          commitCount(0), matchLog(nullptr), idBase(0), hotMatches(0), hotWindow(0), staleLogLines(0),
+          exportRunning(false), exportDone(0), exportTotal(0) {
+        loadFromFile(rebuildStats);
+        publishStatsView();
+        writerThread = thread(&MatchHistoryTracker::writerLoop, this);
+    }
+
+    // Every file a tracker created with filePrefix may have written; keep in step
+    // with the names set up by the constructor
+    static vector<string> dataFiles(const string& filePrefix) {
+        vector<string> files;
+        for (const char* name : {"match_history.txt", "player_stats.txt", "match_history.bin"}) {
+            files.push_back(filePrefix + name);
+        }
+        for (const char* name : {"match_history_export.csv", "match_history_export.ndjson"}) {
+            files.push_back(filePrefix + name);
+            files.push_back(filePrefix + name + ".watermark");
+        }
+        for (const string& segment : MatchSegmentStore::existingFiles(filePrefix + "match_segment")) {
+            files.push_back(segment);
+        }
+        return files;
+    }
+
+    ~MatchHistoryTracker() {
+        waitForExport();
+        queueCheckpoint();
+        {
+            lock_guard<mutex> lock(writerMutex);
+            writerStop = true;
+        }
+        writerWake.notify_one();
+        writerThread.join();
+        if (matchLog) {
+            fclose(matchLog);
+        }
+    }
+
+    // Records a new match and updates statistics
+    void recordMatch(string player1, string player2, int score1, int score2, string stage = "Unknown") {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        string winner = (score1 > score2) ? player1 : player2;
+
+        MatchHistory* newMatch = new MatchHistory(nextMatchID++, player1, player2, score1, score2, winner, stage);
+
+        matchStack.pushFront(newMatch);
+        indexMatch(newMatch);
+
+        applyMatchToStats(*newMatch);
+        addToAggregates(newMatch->stage, newMatch->epochDay, score1, score2);
+        addHeadToHead(stats.indexOf(player1), stats.indexOf(player2), score1, score2,
+                      winner == player1, winner == player2, newMatch->matchID);
+        publishStatsView({stats.indexOf(player1), stats.indexOf(player2)});
+
+        out << "Match recorded successfully!" << endl;
+        appendToLog(newMatch);
+
+        if (++recordsSinceCompaction >= COMPACTION_INTERVAL) {
+            queueCheckpoint();
+        }
+        if (hotWindow > 0) {
+            spillColdMatches(out, hotWindow + max<size_t>(hotWindow / 2, SEGMENT_BLOCK_ROWS * 4));
+        }
+    }
+
+    // Commit at most records log lines per write, waiting up to window for a group
+    // to fill. With fsyncEachCommit, every commit is also forced to the disk.
+    void setGroupCommit(int records, chrono::microseconds window, bool fsyncEachCommit) {
+        lock_guard<mutex> lock(writerMutex);
+        commitRecords = max(records, 1);
+        commitWindow = window;
+        commitFsync = fsyncEachCommit;
+    }
+
+    // Wait until every recorded match has been written to the log
+    void flushLog() {
+        syncWriter();
+    }
+
+    // Number of group commits written so far
+    size_t commits() {
+        lock_guard<mutex> lock(writerMutex);
+        return commitCount;
+    }
+
+    // Write queued log records and checkpoint the statistics now
+    void compactNow() {
+        lock_guard<mutex> lock(trackerMutex);
+        queueCheckpoint();
+        syncWriter();
+    }
+
+    // Keep only the newest matches (about `matches` of them) in memory and spill
+    // older ones to segment files as new ones are recorded. 0 keeps every match.
+    void setHotWindow(int matches) {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        hotWindow = max(matches, 0);
+        spillColdMatches(out, hotWindow);
+    }
+
+    // The latest published statistics; safe to read while other threads record matches
+    shared_ptr<const StatsView> statsSnapshot() const {
+        return atomic_load(&statsView);
+    }
+
+    // Seal every match into match_history.bin and start a fresh, empty log
+    void archiveMatchHistory() {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        syncWriter();    // The writer is idle from here on; this thread queues all its work
+        waitForExport(); // The export may still be reading the rows that are about to move
+        if (matchLog) {
+            fclose(matchLog);
+            matchLog = nullptr;
+        }
+
+        // In-memory matches, oldest first
+        vector<MatchHistory*> recent;
+        for (MatchHistory& match : matchStack) {
+            recent.push_back(&match);
+        }
+        reverse(recent.begin(), recent.end());
+        if (recent.empty()) {
+            out << "No new matches to archive." << endl;
+            return;
+        }
+
+        // Merge the existing archive and the in-memory matches by match ID
+        MatchArchiveWriter writer;
+        writer.reserve(archive.size() + recent.size());
+        size_t row = 0;
+        for (MatchHistory* match : recent) {
+            while (row < archive.size() && archive.value(COL_ID, row) < match->matchID) {
+                writer.addRow(archive, row++);
+            }
+            if (row < archive.size() && archive.value(COL_ID, row) == match->matchID) {
+                row++; // The in-memory copy replaces the archived one
+            }
+            writer.addRow(match);
+        }
+        while (row < archive.size()) {
+            writer.addRow(archive, row++);
+        }
+
+        string tempName = ARCHIVE_FILENAME + ".tmp";
+        if (!writer.save(tempName)) {
+            out << "Error writing " << tempName << "!" << endl;
+            return;
+        }
+        archive.close();
+        if (!replaceFile(tempName, ARCHIVE_FILENAME) || !archive.open(ARCHIVE_FILENAME)) {
+            out << "Error replacing " << ARCHIVE_FILENAME << "!" << endl;
+            return;
+        }
+
+        matchStack.clear();
+        clearMatchIndex();
+
+        // The log only has to hold matches recorded after the archive
+        ofstream(MATCH_FILENAME, ios::trunc).close();
+        dropUnwrittenLog();
+        staleLogLines = 0;
+        writeStatsCheckpoint(snapshotStats(), nextMatchID - 1);
+        recordsSinceCompaction = 0;
+
+        publishStatsView();
+        out << recent.size() << " match(es) archived, " << archive.size()
+            << " match(es) now in " << ARCHIVE_FILENAME << "." << endl;
+    }
+
+    // Compress every archived match into a new segment file and remove the archive
+    void sealArchiveToSegment() {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        if (archive.size() == 0) {
+            out << "The binary archive is empty. Archive some matches first." << endl;
+            return;
+        }
+        waitForExport(); // The export may still be reading the archive
+
+        MatchSegmentWriter writer;
+        for (size_t row = 0; row < archive.size(); row++) {
+            if (!findMatch(archive.value(COL_ID, row))) { // The in-memory copy replaces it
+                writer.addRow(archive, row);
+            }
+        }
+        string filename;
+        if (!segments.add(writer, filename)) {
+            out << "Error writing " << filename << "!" << endl;
+            return;
+        }
+
+        size_t archiveBytes = archive.fileSize();
+        size_t segmentBytes = segments.segment(segments.segmentCount() - 1).fileSize();
+        archive.close();
+        remove(ARCHIVE_FILENAME.c_str());
+
+        out << writer.size() << " match(es) compressed into " << filename << " ("
+            << segmentBytes << " bytes, " << archiveBytes << " bytes in " << ARCHIVE_FILENAME << ").\n"
+            << segments.size() << " match(es) in " << segments.segmentCount() << " segment(s), "
+            << segments.fileSize() << " bytes." << endl;
+    }
+
+    // Display all match history
+    void displayMatchHistory() {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        if (matchStack.empty() && archive.size() == 0 && segments.segmentCount() == 0) {
+            out << "No match history available." << endl;
+            return;
+        }
+
+        out << "\n===== MATCH HISTORY =====\n";
+        out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+        out << "| Match ID |    Player 1    |    Player 2    | Score1 | Score2 |     Winner     |     Stage      |    Date    |\n";
+        out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+
+        for (const MatchHistory& match : matchStack) {
+            printHistoryRow(out, match);
+        }
+        // Archived matches are older than everything in memory, newest first
+        for (size_t row = archive.size(); row-- > 0;) {
+            printHistoryRow(out, archive.readRow(row));
+        }
+        // Then the compressed segments, decoded one block at a time
+        segments.visitBlocks([&out](const MatchSegment& segment, const SegmentBlock& block) {
+            for (size_t row = block.rows; row-- > 0;) {
+                printHistoryRow(out, segment.readRow(block, row));
+            }
+        }, true);
+        out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+    }
+
+    // Search match by ID
+    void searchMatchByID(int matchID) {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        MatchHistory* match = findMatch(matchID);
+        bool found = false;
+
+        if (match) {
+            found = true;
+            printMatchDetails(out, *match);
+        } else {
+            long row = archive.findRow(matchID);
+            MatchHistory sealed(0, "", "", 0, 0, "", "", 0);
+            if (row >= 0) {
+                found = true;
+                printMatchDetails(out, archive.readRow(row));
+            } else if (segments.findMatch(matchID, sealed)) {
+                found = true;
+                printMatchDetails(out, sealed);
+            }
+        }
+
+        if (!found) {
+            out << "No match found with ID " << matchID << "!" << endl;
+        }
+    }
+
+    // Call visit for every match with an ID in [firstID, lastID], in ID order.
+    // Archived rows and the dense in-memory table are both walked as contiguous slices.
+    // Segments, archive and memory are visited in that order: each tier only holds
+    // IDs above the ones in the tier it was sealed into.
+    template <typename Visitor>
+    void visitMatchRange(int firstID, int lastID, Visitor visit) {
+        lock_guard<mutex> lock(trackerMutex);
+        if (firstID > lastID) {
+            return;
+        }
+
+        // Segments hold the oldest matches; only blocks overlapping the range are decoded
+        segments.visitRange(firstID, lastID, [&](const MatchSegment& segment, const SegmentBlock& block, size_t row) {
+            visit(segment.readRow(block, row));
+        });
+
+        // Archive: its ID column is sorted, so the range is one run of rows
+        if (archive.size() > 0) {
+            const int32_t* ids = archive.column(COL_ID);
+            size_t row = lower_bound(ids, ids + archive.size(), firstID) - ids;
+            for (; row < archive.size() && ids[row] <= lastID; row++) {
+                if (!findMatch(ids[row])) { // In-memory copy wins, it is visited below
+                    visit(archive.readRow(row));
+                }
+            }
+        }
+
+        // Outliers kept outside the dense table, merged in by ID
+        vector<MatchHistory*> outliers;
+        for (const auto& entry : sparseMatchIDs) {
+            if (entry.first >= firstID && entry.first <= lastID) {
+                outliers.push_back(entry.second);
+            }
+        }
+        sort(outliers.begin(), outliers.end(), [](const MatchHistory* a, const MatchHistory* b) {
+            return a->matchID < b->matchID;
+        });
+        size_t next = 0;
+
+        long from = max<long>(static_cast<long>(firstID) - idBase, 0);
+        long to = min<long>(static_cast<long>(lastID) - idBase, static_cast<long>(matchByID.size()) - 1);
+        for (long slot = from; slot <= to; slot++) {
+            MatchHistory* match = matchByID[slot];
+            if (!match) {
+                continue; // Hole left by a missing ID
+            }
+            while (next < outliers.size() && outliers[next]->matchID < match->matchID) {
+                visit(*outliers[next++]);
+            }
+            visit(*match);
+        }
+        while (next < outliers.size()) {
+            visit(*outliers[next++]);
+        }
+    }
+
+    // Display every match with an ID between firstID and lastID
+    void displayMatchRange(int firstID, int lastID) {
+        LockedOutput out;
+        int count = 0;
+        visitMatchRange(firstID, lastID, [&count, &out](const MatchHistory& match) {
+            if (count++ == 0) {
+                out << "\n===== MATCH HISTORY =====\n";
+                out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+                out << "| Match ID |    Player 1    |    Player 2    | Score1 | Score2 |     Winner     |     Stage      |    Date    |\n";
+                out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+            }
+            printHistoryRow(out, match);
+        });
+
+        if (count == 0) {
+            out << "No matches found with IDs " << firstID << " to " << lastID << "." << endl;
+        } else {
+            out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+            out << count << " match(es) found.\n";
+        }
+    }
+
+    // Call visit for every match dated between firstDay and lastDay, in date order.
+    // Both the archive and the in-memory matches are looked up through their date
+    // index, so this costs O(log n + matches found).
+    template <typename Visitor>
+    void visitDateRange(int32_t firstDay, int32_t lastDay, Visitor visit) {
+        lock_guard<mutex> lock(trackerMutex);
+        // Segment blocks are pruned by their date range; the rows found are put in date order
+        vector<MatchHistory> cold;
+        segments.visitDays(firstDay, lastDay, [&cold](const MatchSegment& segment, const SegmentBlock& block, size_t row) {
+            cold.push_back(segment.readRow(block, row));
+        });
+        stable_sort(cold.begin(), cold.end(), [](const MatchHistory& a, const MatchHistory& b) {
+            return a.epochDay < b.epochDay;
+        });
+        size_t nextCold = 0;
+        auto visitColdUpTo = [&](int32_t day) {
+            while (nextCold < cold.size() && cold[nextCold].epochDay <= day) {
+                visit(cold[nextCold++]);
+            }
+        };
+
+        auto hotDay = hotMatchesByDay.lower_bound(firstDay);
+        auto hotEnd = hotMatchesByDay.upper_bound(lastDay);
+        auto visitHotDay = [&]() {
+            visitColdUpTo(hotDay->first);
+            for (int matchID : hotDay->second) {
+                visit(*findMatch(matchID));
+            }
+            ++hotDay;
+        };
+
+        archive.visitDayRange(firstDay, lastDay, [&](size_t row) {
+            int32_t day = archive.value(COL_DAY, row);
+            while (hotDay != hotEnd && hotDay->first < day) {
+                visitHotDay();
+            }
+            visitColdUpTo(day);
+            if (!findMatch(archive.value(COL_ID, row))) { // In-memory copy wins
+                visit(archive.readRow(row));
+            }
+        });
+        while (hotDay != hotEnd) {
+            visitHotDay();
+        }
+        visitColdUpTo(lastDay);
+    }
+
+    // Display every match played between two dates
+    void displayMatchesByDate(int32_t firstDay, int32_t lastDay) {
+        LockedOutput out;
+        int count = 0;
+        visitDateRange(firstDay, lastDay, [&count, &out](const MatchHistory& match) {
+            if (count++ == 0) {
+                out << "\n===== MATCH HISTORY =====\n";
+                out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+                out << "| Match ID |    Player 1    |    Player 2    | Score1 | Score2 |     Winner     |     Stage      |    Date    |\n";
+                out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+            }
+            printHistoryRow(out, match);
+        });
+
+        if (count == 0) {
+            out << "No matches played between " << epochDayToDate(firstDay) << " and " << epochDayToDate(lastDay) << "." << endl;
+        } else {
+            out << "+----------+----------------+----------------+--------+--------+----------------+----------------+------------+\n";
+            out << count << " match(es) found.\n";
+        }
+    }
+
+    // Matches and points per day and per week (Monday to Sunday) between two dates,
+    // read from the running per-day totals
+    void displayDailyReport(int32_t firstDay, int32_t lastDay) {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        auto first = dayTotals.lower_bound(firstDay);
+        auto last = dayTotals.upper_bound(lastDay);
+        if (first == last) {
+            out << "No matches played between " << epochDayToDate(firstDay) << " and " << epochDayToDate(lastDay) << "." << endl;
+            return;
+        }
+
+        out << "\n===== MATCHES PER DAY =====\n";
+        map<int32_t, ScoreAggregate> weeks;
+        for (auto it = first; it != last; ++it) {
+            out << "  " << epochDayToDate(it->first) << ": " << it->second.matches << " matches, "
+                << it->second.pointSum << " points\n";
+            int32_t weekStart = it->first - (((it->first + 3) % 7) + 7) % 7; // Epoch day 0 was a Thursday
+            weeks[weekStart].merge(it->second);
+        }
+
+        out << "\n===== POINTS PER WEEK =====\n";
+        for (const auto& week : weeks) {
+            out << "  Week of " << epochDayToDate(week.first) << ": " << week.second.matches << " matches, "
+                << week.second.pointSum << " points (avg " << fixed << setprecision(2)
+                << week.second.averagePointsPerMatch() << " per match)\n";
+        }
+    }
+
+    // Export match history on a background thread, oldest match first. With
+    // onlyNew set, only matches above the watermark left by the last export to the
+    // same file are appended. Progress is shown by displayExportStatus.
+    void exportMatchHistory(ExportFormat format, bool onlyNew) {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        if (exportRunning) {
+            out << "An export is already running. Check Export Status for its progress." << endl;
+            return;
+        }
+        waitForExport();
+
+        string filename = EXPORT_FILENAMES[format];
+        int watermark = 0;
+        if (onlyNew && ifstream(filename)) {
+            watermark = readExportWatermark(filename);
+        }
+
+        // Collect the rows now; the thread only reads records, which never change
+        // once written. archiveMatchHistory waits for the export before freeing them.
+        ExportJob job;
+        job.format = format;
+        job.filename = filename;
+        job.append = watermark > 0;
+        job.watermark = watermark;
+        job.hotRows = collectHotMatches(watermark);
+        if (archive.size() > 0) {
+            const int32_t* ids = archive.column(COL_ID);
+            job.firstArchiveRow = upper_bound(ids, ids + archive.size(), watermark) - ids;
+        } else {
+            job.firstArchiveRow = 0;
+        }
+
+        size_t segmentRows = segments.countAbove(watermark);
+        job.includeSegments = segmentRows > 0;
+
+        size_t total = segmentRows + job.hotRows.size() + (archive.size() - job.firstArchiveRow);
+        if (total == 0) {
+            out << "No new matches to export since match ID " << watermark << "." << endl;
+            return;
+        }
+
+        exportTotal = total;
+        exportDone = 0;
+        exportRunning = true;
+        exportStart = chrono::steady_clock::now();
+        exportThread = thread([this, job]() {
+            runExport(job);
+        });
+        out << "Exporting " << total << " match(es) to " << filename << " in the background." << endl;
+    }
+
+    // Progress of the current or last export
+    void displayExportStatus() {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        if (exportRunning) {
+            size_t done = exportDone, total = exportTotal;
+            out << "Export in progress: " << done << " of " << total << " match(es) written ("
+                << fixed << setprecision(1) << (total ? 100.0 * done / total : 100.0) << "%)." << endl;
+            return;
+        }
+        waitForExport();
+        if (exportResult.empty()) {
+            out << "No export has been started." << endl;
+        } else {
+            out << exportResult << endl;
+        }
+    }
+
+    // Display player statistics
+    void displayPlayerStats() {
+        shared_ptr<const StatsView> view = statsSnapshot();
+        if (view->playerCount == 0) {
+            printLocked("No player statistics available.\n");
+            return;
+        }
+        ostringstream out;
+
+        out << "\n===== PLAYER STATISTICS =====\n";
+        out << "+----------------+----------------+----------------+----------------------+---------------+\n";
+        out << "|   Player Name  | Matches Played |  Matches Won   | Total Points Scored  |   Win Rate    |\n";
+        out << "+----------------+----------------+----------------+----------------------+---------------+\n";
+
+        for (size_t index = 0; index < view->playerCount; index++) {
+            const PlayerStats& player = view->player(index);
+            out << "| " << setw(14) << player.playerName << " | "
+                << setw(14) << player.matchesPlayed << " | "
+                << setw(14) << player.matchesWon << " | "
+                << setw(20) << player.totalPointsScored << " | "
+                << setw(11) << fixed << setprecision(2) << player.winRate * 100 << "% |\n";
+        }
+        out << "+----------------+----------------+----------------+----------------------+---------------+\n";
+        printLocked(out.str());
+    }
+
+    // Find top performers
+    void displayTopPerformers() {
+        shared_ptr<const StatsView> view = statsSnapshot();
+        if (view->playerCount == 0) {
+            printLocked("No player statistics available.\n");
+            return;
+        }
+        ostringstream out;
+
+        const PlayerStats& mostWins = view->player(view->leaders[LB_WINS]);
+        const PlayerStats& highestScorer = view->player(view->leaders[LB_POINTS]);
+        const PlayerStats& highestRated = view->player(view->leaders[LB_RATING]);
+
+        out << "\n===== TOP PERFORMERS =====\n";
+        out << "Player with most wins: " << mostWins.playerName
+            << " (" << mostWins.matchesWon << " wins)\n";
+
+        if (view->leaders[LB_WIN_RATE] >= 0) {
+            const PlayerStats& highestWinRate = view->player(view->leaders[LB_WIN_RATE]);
+            out << "Player with highest win rate (min 3 matches): " << highestWinRate.playerName
+                << " (" << fixed << setprecision(2) << highestWinRate.winRate * 100 << "%)\n";
+        } else {
+            out << "Player with highest win rate (min 3 matches): none yet\n";
+        }
+
+        out << "Player with highest total score: " << highestScorer.playerName
+            << " (" << highestScorer.totalPointsScored << " points)\n";
+
+        out << "Player with highest rating: " << highestRated.playerName
+            << " (" << fixed << setprecision(1) << highestRated.rating << ")\n";
+        printLocked(out.str());
+    }
+
+    // Display the top count players on one leaderboard
+    void displayLeaderboard(LeaderboardMetric metric, int count) {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        const RankedLeaderboard& board = leaderboards[metric];
+        if (board.size() == 0) {
+            out << "No players on the " << LEADERBOARD_NAMES[metric] << " leaderboard yet." << endl;
+            return;
+        }
+
+        out << "\n===== LEADERBOARD: " << LEADERBOARD_NAMES[metric] << " =====\n";
+        int shown = min(count, board.size());
+        for (int rank = 0; rank < shown; rank++) {
+            const PlayerStats& player = stats[board.playerAt(rank)];
+            out << setw(5) << rank + 1 << ". " << setw(14) << player.playerName << "  "
+                << formatLeaderboardScore(metric, player) << "\n";
+        }
+        out << "(" << board.size() << " player(s) ranked)\n";
+    }
+
+    // Display a player's rank on every leaderboard
+    void displayPlayerRank(const string& playerName) {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        int index = stats.indexOf(playerName);
+        if (index < 0) {
+            out << "No statistics found for player " << playerName << "." << endl;
+            return;
+        }
+
+        out << "\n===== RANKINGS FOR " << playerName << " =====\n";
+        for (int metric = 0; metric < LB_COUNT; metric++) {
+            const RankedLeaderboard& board = leaderboards[metric];
+            out << LEADERBOARD_NAMES[metric] << ": ";
+            int rank = board.rankOf(index);
+            if (rank == 0) {
+                out << "not ranked (needs " << MIN_MATCHES_FOR_WIN_RATE << " matches)\n";
+            } else {
+                out << "#" << rank << " of " << board.size() << " ("
+                    << formatLeaderboardScore(static_cast<LeaderboardMetric>(metric), stats[index]) << ")\n";
+            }
+        }
+    }
+
+    // A's record against B, read straight from the head-to-head index
+    void displayHeadToHead(const string& playerA, const string& playerB) {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        int a = stats.indexOf(playerA);
+        int b = stats.indexOf(playerB);
+        const HeadToHead* record = (a >= 0 && b >= 0) ? findHeadToHead(a, b) : nullptr;
+        if (!record) {
+            out << playerA << " and " << playerB << " have not played each other." << endl;
+            return;
+        }
+
+        int sideA = (a < b) ? 0 : 1;
+        int sideB = 1 - sideA;
+        out << "\n===== " << playerA << " vs " << playerB << " =====\n";
+        out << "Matches Played: " << record->matches << "\n";
+        out << playerA << " Wins: " << record->wins[sideA] << "\n";
+        out << playerB << " Wins: " << record->wins[sideB] << "\n";
+        out << "Points: " << record->points[sideA] << " - " << record->points[sideB] << "\n";
+        out << "Last Match ID: " << record->lastMatchID << "\n";
+    }
+
+    // A player's most played opponents and their record against each
+    void displayRivalries(const string& playerName, int count) {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        int index = stats.indexOf(playerName);
+        if (index < 0 || index >= static_cast<int>(opponents.size()) || opponents[index].empty()) {
+            out << "No head-to-head records found for " << playerName << "." << endl;
+            return;
+        }
+
+        vector<pair<const HeadToHead*, int>> rivals;
+        for (int other : opponents[index]) {
+            rivals.emplace_back(findHeadToHead(index, other), other);
+        }
+        size_t shown = min(rivals.size(), static_cast<size_t>(count));
+        partial_sort(rivals.begin(), rivals.begin() + shown, rivals.end(),
+                     [](const pair<const HeadToHead*, int>& x, const pair<const HeadToHead*, int>& y) {
+                         if (x.first->matches != y.first->matches) return x.first->matches > y.first->matches;
+                         return x.first->lastMatchID > y.first->lastMatchID;
+                     });
+
+        out << "\n===== RIVALRIES FOR " << playerName << " =====\n";
+        out << left << setw(20) << "Opponent" << setw(10) << "Matches" << setw(10) << "Won"
+            << setw(10) << "Lost" << setw(12) << "Points" << "Last Match\n";
+        out << string(72, '-') << "\n";
+        for (size_t i = 0; i < shown; i++) {
+            const HeadToHead& record = *rivals[i].first;
+            int own = (index < rivals[i].second) ? 0 : 1;
+            out << left << setw(20) << stats[rivals[i].second].playerName
+                << setw(10) << record.matches
+                << setw(10) << record.wins[own]
+                << setw(10) << record.wins[1 - own]
+                << setw(12) << (to_string(record.points[own]) + "-" + to_string(record.points[1 - own]))
+                << record.lastMatchID << "\n";
+        }
+    }
+
+    // Generate tournament summary
+    void generateTournamentSummary() {
+        lock_guard<mutex> lock(trackerMutex);
+        LockedOutput out;
+        if (overallTotals.matches == 0) {
+            out << "No match data available for summary." << endl;
+            return;
+        }
+
+        out << "\n===== TOURNAMENT SUMMARY =====\n";
+        out << "Total Matches Played: " << overallTotals.matches << "\n";
+        out << "Total Points Scored: " << overallTotals.pointSum << "\n";
+        out << "Average Points Per Match: " << fixed << setprecision(2) << overallTotals.averagePointsPerMatch() << "\n";
+        out << "Score Range: " << overallTotals.minScore << " - " << overallTotals.maxScore
+            << " (mean " << overallTotals.mean << ", variance " << overallTotals.variance() << ")\n\n";
+
+        out << "Matches by Stage:\n";
+        for (const auto& stage : stageTotals) {
+            const ScoreAggregate& totals = stage.second;
+            out << "  " << stage.first << ": " << totals.matches << " matches, "
+                << totals.pointSum << " points, scores " << totals.minScore << "-" << totals.maxScore
+                << " (mean " << totals.mean << ", variance " << totals.variance() << ")\n";
+        }
+    }
+
+private:
+    static void printLocked(const string& text) {
+        lock_guard<mutex> lock(consoleMutex);
+        cout << text << flush;
+    }
+
+    // Publish a view with every player copied from the live table
+    void publishStatsView() {
+        auto view = make_shared<StatsView>();
+        shared_ptr<const StatsView> old = atomic_load(&statsView);
+        view->version = old ? old->version + 1 : 1;
+        view->playerCount = stats.size();
+        shared_ptr<StatsView::Page> page;
+        for (size_t first = 0; first < stats.size(); first += STATS_VIEW_CHUNK) {
+            if (!page || page->size() == STATS_VIEW_PAGE) {
+                page = make_shared<StatsView::Page>();
+                view->pages.push_back(page);
+            }
+            size_t last = min(first + STATS_VIEW_CHUNK, stats.size());
+            page->push_back(make_shared<const StatsView::Chunk>(stats.begin() + first, stats.begin() + last));
+        }
+        finishStatsView(*view);
+        atomic_store(&statsView, shared_ptr<const StatsView>(move(view)));
+    }
+
+    // Publish a view in which only the changed players are brought up to date.
+    // Their chunks and the pages holding them are copied; the page list is one
+    // pointer per STATS_VIEW_PAGE chunks, and every other page is shared.
+    void publishStatsView(initializer_list<int> changed) {
+        shared_ptr<const StatsView> old = atomic_load(&statsView);
+        auto view = make_shared<StatsView>(*old);
+        view->version = old->version + 1;
+        view->playerCount = stats.size();
+        for (int index : changed) {
+            size_t chunk = index / STATS_VIEW_CHUNK;
+            size_t first = chunk * STATS_VIEW_CHUNK;
+            size_t last = min(first + STATS_VIEW_CHUNK, stats.size());
+            size_t pageIndex = chunk / STATS_VIEW_PAGE;
+            if (pageIndex >= view->pages.size()) {
+                view->pages.resize(pageIndex + 1); // First chunk of a new page
+            }
+            // Copy the page, then swap the changed chunk into the copy
+            shared_ptr<const StatsView::Page>& slot = view->pages[pageIndex];
+            auto page = slot ? make_shared<StatsView::Page>(*slot) : make_shared<StatsView::Page>();
+            if (chunk % STATS_VIEW_PAGE >= page->size()) {
+                page->resize(chunk % STATS_VIEW_PAGE + 1); // First player of a new chunk
+            }
+            (*page)[chunk % STATS_VIEW_PAGE] = make_shared<const StatsView::Chunk>(stats.begin() + first,
+                                                                                  stats.begin() + last);
+            slot = move(page);
+        }
+        finishStatsView(*view);
+        atomic_store(&statsView, shared_ptr<const StatsView>(move(view)));
+    }
+
+    void finishStatsView(StatsView& view) {
+        view.lastMatchID = nextMatchID - 1;
+        for (int metric = 0; metric < LB_COUNT; metric++) {
+            view.leaders[metric] = leaderboards[metric].size() > 0 ? leaderboards[metric].playerAt(0) : -1;
+        }
+    }
+
+    // In-memory match with this ID, or nullptr
+    MatchHistory* findMatch(int matchID) {
+        long slot = static_cast<long>(matchID) - idBase;
+        if (slot >= 0 && slot < static_cast<long>(matchByID.size())) {
+            if (matchByID[slot]) {
+                return matchByID[slot];
+            }
+        }
+        auto it = sparseMatchIDs.find(matchID);
+        return it != sparseMatchIDs.end() ? it->second : nullptr;
+    }
+
+    // Add an in-memory match to the date and ID indexes
+    void indexMatch(MatchHistory* match) {
+        hotMatchesByDay[match->epochDay].push_back(match->matchID);
+        hotMatches++;
+
+        if (matchByID.empty() && sparseMatchIDs.empty()) {
+            idBase = match->matchID;
+        }
+        long slot = static_cast<long>(match->matchID) - idBase;
+        // Only grow the dense table while it stays reasonably full
+        long limit = static_cast<long>(matchByID.size()) * 2 + 1024;
+        if (slot < 0 || slot >= limit) {
+            sparseMatchIDs[match->matchID] = match;
+            return;
+        }
+        if (slot >= static_cast<long>(matchByID.size())) {
+            matchByID.resize(slot + 1, nullptr);
+        }
+        matchByID[slot] = match;
+    }
+
+    void clearMatchIndex() {
+        matchByID.clear();
+        sparseMatchIDs.clear();
+        hotMatchesByDay.clear();
+        idBase = 0;
+        hotMatches = 0;
+    }
+
+    // Once more than threshold matches are in memory, move all but the newest
+    // hotWindow of them into a segment. They are merged into the newest segment
+    // while it stays under SEGMENT_MAX_ROWS, otherwise a new one is started. Any
+    // archived rows go in as well, since every segment must be older than the archive.
+    // The log is only rewritten once its spilled lines outnumber the kept ones;
+    // until then loadFromFile skips lines that a segment already holds.
+    void spillColdMatches(ostream& out, size_t threshold) {
+        if (hotWindow == 0 || hotMatches <= threshold) {
+            return;
+        }
+        if (exportRunning) {
+            return; // The export is reading in-memory rows; try again on a later match
+        }
+        waitForExport();
+
+        vector<const MatchHistory*> rows = collectHotMatches(0);
+        size_t spilled = rows.size() - hotWindow;
+        int lastSpilledID = rows[spilled - 1]->matchID;
+
+        // Start from the newest segment's rows when there is room for the new ones
+        MatchSegmentWriter writer;
+        bool mergeNewest = segments.segmentCount() > 0 &&
+            segments.segment(segments.segmentCount() - 1).size() + archive.size() + spilled <= SEGMENT_MAX_ROWS;
+        if (mergeNewest && !writer.addRows(segments.segment(segments.segmentCount() - 1))) {
+            writer = MatchSegmentWriter();
+            mergeNewest = false;
+        }
+
+        // Merge the archive and the oldest in-memory matches by match ID
+        size_t row = 0;
+        for (size_t i = 0; i < spilled; i++) {
+            for (; row < archive.size() && archive.value(COL_ID, row) < rows[i]->matchID; row++) {
+                writer.addRow(archive, row);
+            }
+            if (row < archive.size() && archive.value(COL_ID, row) == rows[i]->matchID) {
+                row++; // The in-memory copy replaces the archived one
+            }
+            writer.addRow(rows[i]);
+        }
+        for (; row < archive.size(); row++) {
+            if (!findMatch(archive.value(COL_ID, row))) {
+                writer.addRow(archive, row);
+            }
+        }
+        // The segment is complete on disk before the archive goes; if the program
+        // stops in between, loadFromFile removes the leftover archive
+        string filename;
+        if (!segments.add(writer, filename, mergeNewest)) {
+            out << "Error writing " << filename << "! Keeping every match in memory." << endl;
+            hotWindow = 0;
+            return;
+        }
+        if (archive.size() > 0) {
+            archive.close();
+            remove(ARCHIVE_FILENAME.c_str());
+        }
+
+        // Unlink the spilled matches and index the rest again, oldest first
+        matchStack.removeIf([lastSpilledID](const MatchHistory& match) { return match.matchID <= lastSpilledID; });
+        vector<MatchHistory*> kept;
+        for (MatchHistory& match : matchStack) {
+            kept.push_back(&match);
+        }
+        reverse(kept.begin(), kept.end());
+        clearMatchIndex();
+        for (MatchHistory* match : kept) {
+            indexMatch(match);
+        }
+
+        staleLogLines += spilled;
+        if (staleLogLines > kept.size()) {
+            syncWriter(); // The log is rewritten below, so the writer must be idle
+            if (matchLog) {
+                fclose(matchLog);
+                matchLog = nullptr;
+            }
+            if (rewriteMatchLog(kept)) {
+                dropUnwrittenLog();
+                staleLogLines = 0;
+            }
+        }
+
+        publishStatsView();
+        out << spilled << " older match(es) moved to " << filename << "." << endl;
+    }
+
+    static void printHistoryRow(ostream& out, const MatchHistory& match) {
+        out << "| " << setw(8) << match.matchID << " | "
+            << setw(14) << match.player1 << " | "
+            << setw(14) << match.player2 << " | "
+            << setw(6) << match.score1 << " | "
+            << setw(6) << match.score2 << " | "
+            << setw(14) << match.winner << " | "
+            << setw(14) << match.stage << " | "
+            << setw(10) << match.date() << " |\n";
+    }
+
+    static void printMatchDetails(ostream& out, const MatchHistory& match) {
+        out << "\n===== MATCH DETAILS =====\n";
+        out << "Match ID: " << match.matchID << "\n"
+            << "Date: " << match.date() << "\n"
+            << "Stage: " << match.stage << "\n"
+            << "Player 1: " << match.player1 << "\n"
+            << "Player 2: " << match.player2 << "\n"
+            << "Score: " << match.score1 << " - " << match.score2 << "\n"
+            << "Winner: " << match.winner << "\n";
+    }
+
+    // In-memory matches with an ID above afterID, in ID order
+    vector<const MatchHistory*> collectHotMatches(int afterID) {
+        vector<const MatchHistory*> rows;
+        long from = max<long>(static_cast<long>(afterID) + 1 - idBase, 0);
+        for (long slot = from; slot < static_cast<long>(matchByID.size()); slot++) {
+            if (matchByID[slot]) rows.push_back(matchByID[slot]);
+        }
+        if (!sparseMatchIDs.empty()) {
+            for (const auto& entry : sparseMatchIDs) {
+                if (entry.first > afterID) rows.push_back(entry.second);
+            }
+            sort(rows.begin(), rows.end(), [](const MatchHistory* a, const MatchHistory* b) {
+                return a->matchID < b->matchID;
+            });
+        }
+        return rows;
+    }
+
+    static int readExportWatermark(const string& filename) {
+        ifstream file(filename + ".watermark");
+        int watermark = 0;
+        if (!(file >> watermark) || watermark < 0) {
+            return 0;
+        }
+        return watermark;
+    }
+
+    static void appendNumber(string& out, int value) {
+        char digits[16];
+        char* last = to_chars(digits, digits + sizeof(digits), value).ptr;
+        out.append(digits, last - digits);
+    }
+
+    static void appendJsonString(string& out, string_view text) {
+        out += '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    static void appendExportRow(string& out, ExportFormat format, int matchID, const string& date,
+                                string_view stage, string_view player1, string_view player2,
+                                int score1, int score2, string_view winner) {
+        if (format == EXPORT_CSV) {
+            appendNumber(out, matchID);
+            out += ',';
+            out += date;
+            out += ',';
+            out += stage;
+            out += ',';
+            out += player1;
+            out += ',';
+            out += player2;
+            out += ',';
+            appendNumber(out, score1);
+            out += ',';
+            appendNumber(out, score2);
+            out += ',';
+            out += winner;
+            out += '\n';
+        } else {
+            out += "{\"matchID\":";
+            appendNumber(out, matchID);
+            out += ",\"date\":";
+            appendJsonString(out, date);
+            out += ",\"stage\":";
+            appendJsonString(out, stage);
+            out += ",\"player1\":";
+            appendJsonString(out, player1);
+            out += ",\"player2\":";
+            appendJsonString(out, player2);
+            out += ",\"score1\":";
+            appendNumber(out, score1);
+            out += ",\"score2\":";
+            appendNumber(out, score2);
+            out += ",\"winner\":";
+            appendJsonString(out, winner);
+            out += "}\n";
+        }
+    }
+
+    // Body of the export thread: merge archive and in-memory rows by match ID into
+    // a large buffer that is written out in EXPORT_BUFFER_SIZE chunks
+    void runExport(const ExportJob& job) {
+        FILE* file = fopen(job.filename.c_str(), job.append ? "ab" : "wb");
+        if (!file) {
+            exportResult = "Error opening " + job.filename + " for export!";
+            exportRunning = false;
+            return;
+        }
+
+        string out;
+        out.reserve(EXPORT_BUFFER_SIZE + 4096);
+        if (!job.append && job.format == EXPORT_CSV) {
+            out += "Match ID,Date,Stage,Player 1,Player 2,Score 1,Score 2,Winner\n";
+        }
+
+        bool ok = true;
+        size_t done = 0;
+        int lastID = job.watermark;
+        int32_t lastDay = INVALID_EPOCH_DAY;
+        string lastDate;
+        auto dateOf = [&](int32_t day) -> const string& {
+            if (day != lastDay) { // Rows come mostly in date order
+                lastDate = epochDayToDate(day);
+                lastDay = day;
+            }
+            return lastDate;
+        };
+        auto rowWritten = [&]() {
+            if (out.size() >= EXPORT_BUFFER_SIZE) {
+                ok = ok && fwrite(out.data(), 1, out.size(), file) == out.size();
+                out.clear();
+            }
+            if ((++done & 1023) == 0) exportDone = done;
+        };
+
+        // Segments first: they hold the oldest IDs
+        if (job.includeSegments) {
+            segments.visitRange(job.watermark + 1, INT_MAX,
+                [&](const MatchSegment& segment, const SegmentBlock& block, size_t row) {
+                    appendExportRow(out, job.format, block.columns[COL_ID][row], dateOf(block.columns[COL_DAY][row]),
+                                    segment.stageName(block.columns[COL_STAGE][row]),
+                                    segment.playerName(block.columns[COL_PLAYER1][row]),
+                                    segment.playerName(block.columns[COL_PLAYER2][row]),
+                                    block.columns[COL_SCORE1][row], block.columns[COL_SCORE2][row],
+                                    segment.playerName(block.columns[COL_WINNER][row]));
+                    rowWritten();
+                });
+            lastID = max(lastID, segments.maxMatchID());
+        }
+
+        size_t row = job.firstArchiveRow;
+        size_t rows = archive.size();
+        for (const MatchHistory* match : job.hotRows) {
+            while (row < rows && archive.value(COL_ID, row) < match->matchID) {
+                appendExportRow(out, job.format, archive.value(COL_ID, row), dateOf(archive.value(COL_DAY, row)),
+                                archive.stageName(archive.value(COL_STAGE, row)),
+                                archive.playerName(archive.value(COL_PLAYER1, row)),
+                                archive.playerName(archive.value(COL_PLAYER2, row)),
+                                archive.value(COL_SCORE1, row), archive.value(COL_SCORE2, row),
+                                archive.playerName(archive.value(COL_WINNER, row)));
+                row++;
+                rowWritten();
+            }
+            if (row < rows && archive.value(COL_ID, row) == match->matchID) {
+                row++; // The in-memory copy replaces the archived one
+            }
+            appendExportRow(out, job.format, match->matchID, dateOf(match->epochDay), match->stage,
+                            match->player1, match->player2, match->score1, match->score2, match->winner);
+            rowWritten();
+        }
+        for (; row < rows; row++) {
+            appendExportRow(out, job.format, archive.value(COL_ID, row), dateOf(archive.value(COL_DAY, row)),
+                            archive.stageName(archive.value(COL_STAGE, row)),
+                            archive.playerName(archive.value(COL_PLAYER1, row)),
+                            archive.playerName(archive.value(COL_PLAYER2, row)),
+                            archive.value(COL_SCORE1, row), archive.value(COL_SCORE2, row),
+                            archive.playerName(archive.value(COL_WINNER, row)));
+            rowWritten();
+        }
+        if (!job.hotRows.empty()) lastID = max(lastID, job.hotRows.back()->matchID);
+        if (job.firstArchiveRow < rows) lastID = max(lastID, archive.value(COL_ID, rows - 1));
+
+        ok = ok && fwrite(out.data(), 1, out.size(), file) == out.size();
+        ok = (fclose(file) == 0) && ok;
+        exportDone = done;
+
+        if (ok) {
+            // Only move the watermark once the rows are safely written
+            string tempName = job.filename + ".watermark.tmp";
+            ofstream(tempName) << lastID << "\n";
+            replaceFile(tempName, job.filename + ".watermark");
+
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - exportStart).count();
+            ostringstream result;
+            result << "Export finished: " << done << " match(es) " << (job.append ? "appended to " : "written to ")
+                   << job.filename << " in " << fixed << setprecision(2) << seconds
+                   << " s. Last exported match ID: " << lastID << ".";
+            exportResult = result.str();
+        } else {
+            exportResult = "Error writing " + job.filename + "; the export watermark was not moved.";
+        }
+        exportRunning = false;
+    }
+
+    void waitForExport() {
+        if (exportThread.joinable()) {
+            exportThread.join();
+        }
+    }
+
+    // Add one match to the overall, per-stage and per-day totals
+    void addToAggregates(const string& stage, int32_t epochDay, int score1, int score2) {
+        overallTotals.addMatch(score1, score2);
+        stageTotals[stage].addMatch(score1, score2);
+        dayTotals[epochDay].addMatch(score1, score2);
+    }
+
+    // Rebuild the totals from the archive columns and the in-memory matches. Archived
+    // rows that also live in memory are counted once, from the in-memory copy.
+    void rebuildAggregates() {
+        overallTotals = ScoreAggregate();
+        stageTotals.clear();
+        dayTotals.clear();
+
+        if (archive.size() > 0) {
+            // Group archived rows by stage code first so the map is only touched once per stage.
+            // MatchArchive::open has checked every stage code against the name table.
+            vector<ScoreAggregate> perStage(archive.stageCount());
+            unordered_map<int32_t, ScoreAggregate> perDay;
+            const int32_t* ids = archive.column(COL_ID);
+            const int32_t* stageColumn = archive.column(COL_STAGE);
+            const int32_t* dayColumn = archive.column(COL_DAY);
+            const int32_t* scores1 = archive.column(COL_SCORE1);
+            const int32_t* scores2 = archive.column(COL_SCORE2);
+            for (size_t row = 0; row < archive.size(); row++) {
+                if (findMatch(ids[row])) {
+                    continue; // The in-memory copy is counted below
+                }
+                perStage[stageColumn[row]].addMatch(scores1[row], scores2[row]);
+                perDay[dayColumn[row]].addMatch(scores1[row], scores2[row]);
+            }
+            for (uint32_t stage = 0; stage < archive.stageCount(); stage++) {
+                if (perStage[stage].matches > 0) {
+                    overallTotals.merge(perStage[stage]);
+                    stageTotals[string(archive.stageName(stage))].merge(perStage[stage]);
+                }
+            }
+            for (const auto& day : perDay) {
+                dayTotals[day.first].merge(day.second);
+            }
+        }
+
+        // Segments: the same grouping, one block at a time
+        segments.visitBlocks([this](const MatchSegment& segment, const SegmentBlock& block) {
+            vector<ScoreAggregate> perStage(segment.stageCount());
+            for (size_t row = 0; row < block.rows; row++) {
+                int32_t score1 = block.columns[COL_SCORE1][row];
+                int32_t score2 = block.columns[COL_SCORE2][row];
+                perStage[block.columns[COL_STAGE][row]].addMatch(score1, score2);
+                dayTotals[block.columns[COL_DAY][row]].addMatch(score1, score2);
+            }
+            for (uint32_t stage = 0; stage < segment.stageCount(); stage++) {
+                if (perStage[stage].matches > 0) {
+                    overallTotals.merge(perStage[stage]);
+                    stageTotals[string(segment.stageName(stage))].merge(perStage[stage]);
+                }
+            }
+        });
+
+        for (const MatchHistory& match : matchStack) {
+            addToAggregates(match.stage, match.epochDay, match.score1, match.score2);
+        }
+    }
+
+    static uint64_t pairKey(int a, int b) {
+        if (a > b) swap(a, b);
+        return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+    }
+
+    const HeadToHead* findHeadToHead(int a, int b) const {
+        auto it = headToHead.find(pairKey(a, b));
+        return it != headToHead.end() ? &it->second : nullptr;
+    }
+
+    // Count one match between the players at statistics indexes first and second
+    void addHeadToHead(int first, int second, int score1, int score2, bool firstWon, bool secondWon, int matchID) {
+        if (first < 0 || second < 0 || first == second) {
+            return;
+        }
+        HeadToHead& record = headToHead[pairKey(first, second)];
+        if (record.matches == 0) {
+            int highest = max(first, second);
+            if (highest >= static_cast<int>(opponents.size())) {
+                opponents.resize(highest + 1);
+            }
+            opponents[first].push_back(second);
+            opponents[second].push_back(first);
+        }
+        int sideFirst = (first < second) ? 0 : 1;
+        record.matches++;
+        record.wins[sideFirst] += firstWon ? 1 : 0;
+        record.wins[1 - sideFirst] += secondWon ? 1 : 0;
+        record.points[sideFirst] += score1;
+        record.points[1 - sideFirst] += score2;
+        record.lastMatchID = max(record.lastMatchID, matchID);
+    }
+
+    // Rebuild the head-to-head index in one pass over the archive and the in-memory matches
+    void rebuildHeadToHead() {
+        headToHead.clear();
+        opponents.assign(stats.size(), vector<int>());
+
+        if (archive.size() > 0) {
+            // Translate archive player codes to statistics indexes once per player.
+            // MatchArchive::open has checked every code against the player table.
+            vector<int> indexOfCode(archive.playerCount());
+            for (uint32_t code = 0; code < archive.playerCount(); code++) {
+                indexOfCode[code] = stats.findOrCreate(archive.playerName(code));
+            }
+            const int32_t* ids = archive.column(COL_ID);
+            const int32_t* players1 = archive.column(COL_PLAYER1);
+            const int32_t* players2 = archive.column(COL_PLAYER2);
+            const int32_t* winners = archive.column(COL_WINNER);
+            const int32_t* scores1 = archive.column(COL_SCORE1);
+            const int32_t* scores2 = archive.column(COL_SCORE2);
+            for (size_t row = 0; row < archive.size(); row++) {
+                if (findMatch(ids[row])) {
+                    continue; // The in-memory copy is counted below
+                }
+                addHeadToHead(indexOfCode[players1[row]], indexOfCode[players2[row]], scores1[row], scores2[row],
+                              winners[row] == players1[row], winners[row] == players2[row], ids[row]);
+            }
+        }
+
+        segments.visitBlocks([this](const MatchSegment& segment, const SegmentBlock& block) {
+            vector<int> indexOfCode(segment.playerCount(), -1);
+            auto indexOf = [&](int32_t code) {
+                if (indexOfCode[code] < 0) indexOfCode[code] = stats.findOrCreate(segment.playerName(code));
+                return indexOfCode[code];
+            };
+            for (size_t row = 0; row < block.rows; row++) {
+                int32_t player1 = block.columns[COL_PLAYER1][row];
+                int32_t player2 = block.columns[COL_PLAYER2][row];
+                int32_t winner = block.columns[COL_WINNER][row];
+                addHeadToHead(indexOf(player1), indexOf(player2), block.columns[COL_SCORE1][row],
+                              block.columns[COL_SCORE2][row], winner == player1, winner == player2,
+                              block.columns[COL_ID][row]);
+            }
+        });
+
+        for (const MatchHistory& match : matchStack) {
+            addHeadToHead(stats.findOrCreate(match.player1), stats.findOrCreate(match.player2),
+                          match.score1, match.score2, match.winner == match.player1,
+                          match.winner == match.player2, match.matchID);
+        }
+    }
+
+    // Recompute statistics, ratings and running totals from the match history instead
+    // of reading player_stats.txt. The history is cut into chunks that worker threads
+    // count into private partial results, merged at the end. Elo ratings depend on
+    // match order, so one more thread replays them in ID order while the others count;
+    // it also adds the players to the table in order of first appearance.
+    void rebuildStatsInParallel() {
+        auto started = chrono::steady_clock::now();
+        const int FROM_ARCHIVE = -1;
+        const int FROM_MEMORY = -2;
+        const size_t CHUNK_ROWS = 16384;
+
+        stats.clear();
+        for (RankedLeaderboard& board : leaderboards) board.clear();
+        overallTotals = ScoreAggregate();
+        stageTotals.clear();
+        dayTotals.clear();
+
+        vector<const MatchHistory*> hot = collectHotMatches(INT_MIN);
+        size_t totalRows = segments.size() + archive.size() + hot.size();
+
+        vector<RebuildChunk> chunks;
+        for (size_t s = 0; s < segments.segmentCount(); s++) {
+            size_t blocksPerChunk = max<size_t>(CHUNK_ROWS / SEGMENT_BLOCK_ROWS, 1);
+            for (size_t b = 0; b < segments.segment(s).blockCount(); b += blocksPerChunk) {
+                chunks.push_back({static_cast<int>(s), b, min(b + blocksPerChunk, segments.segment(s).blockCount())});
+            }
+        }
+        for (size_t row = 0; row < archive.size(); row += CHUNK_ROWS) {
+            chunks.push_back({FROM_ARCHIVE, row, min(row + CHUNK_ROWS, archive.size())});
+        }
+        for (size_t i = 0; i < hot.size(); i += CHUNK_ROWS) {
+            chunks.push_back({FROM_MEMORY, i, min(i + CHUNK_ROWS, hot.size())});
+        }
+
+        unsigned workers = max(1u, min(thread::hardware_concurrency(), 16u));
+        workers = static_cast<unsigned>(min<size_t>(workers, max<size_t>(chunks.size(), 1)));
+        vector<RebuildPartial> partials(workers);
+        atomic<size_t> nextChunk(0);
+
+        // Count rows of an archive or a decoded segment block. Name codes are
+        // translated to partial table positions once per source; both sources have
+        // checked them against their name tables. With skipHeld set, rows whose match
+        // is also in memory are left to the in-memory pass, as in the other rebuilds.
+        auto countCoded = [this](RebuildPartial& partial, const auto& source, const int32_t* const* columns,
+                                 size_t first, size_t last, vector<int>& playerOf, vector<ScoreAggregate*>& stageOf,
+                                 bool skipHeld) {
+            for (size_t row = first; row < last; row++) {
+                if (skipHeld && findMatch(columns[COL_ID][row])) {
+                    continue;
+                }
+                int32_t player1 = columns[COL_PLAYER1][row];
+                int32_t player2 = columns[COL_PLAYER2][row];
+                int32_t winner = columns[COL_WINNER][row];
+                int32_t stage = columns[COL_STAGE][row];
+                if (playerOf[player1] < 0) playerOf[player1] = partial.players.findOrCreate(source.playerName(player1));
+                if (playerOf[player2] < 0) playerOf[player2] = partial.players.findOrCreate(source.playerName(player2));
+                if (!stageOf[stage]) stageOf[stage] = &partial.stages[string(source.stageName(stage))];
+                countMatch(partial, playerOf[player1], playerOf[player2], columns[COL_SCORE1][row],
+                           columns[COL_SCORE2][row], winner == player1, winner == player2, *stageOf[stage],
+                           columns[COL_DAY][row]);
+            }
+        };
+
+        auto work = [&](RebuildPartial& partial) {
+            SegmentBlock block;
+            vector<int> playerOf;
+            vector<ScoreAggregate*> stageOf;
+            int cachedSource = INT_MIN;
+            size_t index;
+            while ((index = nextChunk++) < chunks.size()) {
+                const RebuildChunk& chunk = chunks[index];
+                if (chunk.source == FROM_MEMORY) {
+                    for (size_t i = chunk.first; i < chunk.last; i++) {
+                        const MatchHistory& match = *hot[i];
+                        countMatch(partial, partial.players.findOrCreate(match.player1),
+                                   partial.players.findOrCreate(match.player2), match.score1, match.score2,
+                                   match.winner == match.player1, match.winner == match.player2,
+                                   partial.stages[match.stage], match.epochDay);
+                    }
+                    continue;
+                }
+                if (chunk.source != cachedSource) {
+                    uint32_t players = chunk.source == FROM_ARCHIVE ? archive.playerCount() : segments.segment(chunk.source).playerCount();
+                    uint32_t stages = chunk.source == FROM_ARCHIVE ? archive.stageCount() : segments.segment(chunk.source).stageCount();
+                    playerOf.assign(players, -1);
+                    stageOf.assign(stages, nullptr);
+                    cachedSource = chunk.source;
+                }
+                if (chunk.source == FROM_ARCHIVE) {
+                    const int32_t* columns[8];
+                    for (int c = 0; c < 8; c++) columns[c] = archive.column(static_cast<ArchiveColumn>(c));
+                    countCoded(partial, archive, columns, chunk.first, chunk.last, playerOf, stageOf, true);
+                } else {
+                    const MatchSegment& segment = segments.segment(chunk.source);
+                    for (size_t b = chunk.first; b < chunk.last; b++) {
+                        if (!segment.decodeBlock(b, block)) continue;
+                        const int32_t* columns[8];
+                        for (int c = 0; c < 8; c++) columns[c] = block.columns[c].data();
+                        countCoded(partial, segment, columns, 0, block.rows, playerOf, stageOf, false);
+                    }
+                }
+            }
+        };
+
+        // Ratings, replayed in ID order: segments, then the archive, then memory
+        thread ratingThread([&]() {
+            auto rate = [this](int first, int second, bool firstWon) {
+                if (first == second) return;
+                PlayerStats& a = stats[first];
+                PlayerStats& b = stats[second];
+                double expectedA = 1.0 / (1.0 + pow(10.0, (b.rating - a.rating) / 400.0));
+                double change = ELO_K_FACTOR * ((firstWon ? 1.0 : 0.0) - expectedA);
+                a.rating += change;
+                b.rating -= change;
+            };
+            auto rateCoded = [&](const auto& source, const int32_t* const* columns, size_t rows, vector<int>& playerOf,
+                                 bool skipHeld) {
+                for (size_t row = 0; row < rows; row++) {
+                    if (skipHeld && findMatch(columns[COL_ID][row])) {
+                        continue; // Rated from the in-memory copy
+                    }
+                    int32_t player1 = columns[COL_PLAYER1][row];
+                    int32_t player2 = columns[COL_PLAYER2][row];
+                    if (playerOf[player1] < 0) playerOf[player1] = stats.findOrCreate(source.playerName(player1));
+                    if (playerOf[player2] < 0) playerOf[player2] = stats.findOrCreate(source.playerName(player2));
+                    rate(playerOf[player1], playerOf[player2], columns[COL_WINNER][row] == player1);
+                }
+            };
+
+            vector<int> playerOf;
+            const MatchSegment* cachedSegment = nullptr;
+            segments.visitBlocks([&](const MatchSegment& segment, const SegmentBlock& block) {
+                if (&segment != cachedSegment) {
+                    playerOf.assign(segment.playerCount(), -1);
+                    cachedSegment = &segment;
+                }
+                const int32_t* columns[8];
+                for (int c = 0; c < 8; c++) columns[c] = block.columns[c].data();
+                rateCoded(segment, columns, block.rows, playerOf, false);
+            });
+            if (archive.size() > 0) {
+                playerOf.assign(archive.playerCount(), -1);
+                const int32_t* columns[8];
+                for (int c = 0; c < 8; c++) columns[c] = archive.column(static_cast<ArchiveColumn>(c));
+                rateCoded(archive, columns, archive.size(), playerOf, true);
+            }
+            for (const MatchHistory* match : hot) {
+                int first = stats.findOrCreate(match->player1);
+                int second = stats.findOrCreate(match->player2);
+                rate(first, second, match->winner == match->player1);
+            }
+        });
+
+        vector<thread> threads;
+        for (unsigned t = 1; t < workers; t++) {
+            threads.emplace_back(work, ref(partials[t]));
+        }
+        work(partials[0]);
+        for (thread& worker : threads) worker.join();
+        ratingThread.join();
+
+        // Merge the partial results
+        for (const RebuildPartial& partial : partials) {
+            for (const PlayerStats& counted : partial.players) {
+                PlayerStats& player = stats[stats.findOrCreate(counted.playerName)];
+                player.matchesPlayed += counted.matchesPlayed;
+                player.matchesWon += counted.matchesWon;
+                player.totalPointsScored += counted.totalPointsScored;
+            }
+            overallTotals.merge(partial.overall);
+            for (const auto& stage : partial.stages) stageTotals[stage.first].merge(stage.second);
+            for (const auto& day : partial.days) dayTotals[day.first].merge(day.second);
+        }
+        for (size_t index = 0; index < stats.size(); index++) {
+            PlayerStats& player = stats[index];
+            player.winRate = player.matchesPlayed ? static_cast<double>(player.matchesWon) / player.matchesPlayed : 0.0;
+            updateLeaderboards(static_cast<int>(index));
+        }
+
+        publishStatsView();
+
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        LockedOutput out; // Shards are loaded on several threads at once
+        out << "Statistics rebuilt from " << totalRows << " match(es) on " << workers + 1 << " thread(s) in "
+            << fixed << setprecision(1) << milliseconds << " ms." << endl;
+    }
+
+    // Count one match into a rebuild thread's partial results
+    static void countMatch(RebuildPartial& partial, int first, int second, int score1, int score2,
+                           bool firstWon, bool secondWon, ScoreAggregate& stage, int32_t epochDay) {
+        PlayerStats& player1 = partial.players[first];
+        player1.matchesPlayed++;
+        player1.totalPointsScored += score1;
+        player1.matchesWon += firstWon ? 1 : 0;
+        PlayerStats& player2 = partial.players[second];
+        player2.matchesPlayed++;
+        player2.totalPointsScored += score2;
+        player2.matchesWon += secondWon ? 1 : 0;
+
+        partial.overall.addMatch(score1, score2);
+        stage.addMatch(score1, score2);
+        partial.days[epochDay].addMatch(score1, score2);
+    }
+
+    // Update both players' statistics, ratings and leaderboard positions for one match
+    void applyMatchToStats(const MatchHistory& match) {
+        int first = updatePlayerStats(match.player1, match.score1, match.winner == match.player1);
+        int second = updatePlayerStats(match.player2, match.score2, match.winner == match.player2);
+
+        if (first != second) {
+            // Elo: move each rating towards the result by how unexpected it was
+            PlayerStats& a = stats[first];
+            PlayerStats& b = stats[second];
+            double expectedA = 1.0 / (1.0 + pow(10.0, (b.rating - a.rating) / 400.0));
+            double resultA = (match.winner == match.player1) ? 1.0 : 0.0;
+            double change = ELO_K_FACTOR * (resultA - expectedA);
+            a.rating += change;
+            b.rating -= change;
+        }
+
+        updateLeaderboards(first);
+        updateLeaderboards(second);
+    }
+
+    // Update or create player statistics, returning the player's position in the table
+    int updatePlayerStats(const string& playerName, int pointsScored, bool isWinner) {
+        int index = stats.findOrCreate(playerName);
+        PlayerStats* player = &stats[index];
+
+        player->matchesPlayed++;
+        player->totalPointsScored += pointsScored;
+
+        if (isWinner) {
+            player->matchesWon++;
+        }
+
+        // Update win rate
+        player->winRate = static_cast<double>(player->matchesWon) / player->matchesPlayed;
+        return index;
+    }
+
+    // Move a player to their current position on every leaderboard
+    void updateLeaderboards(int index) {
+        const PlayerStats& player = stats[index];
+        leaderboards[LB_WINS].set(index, player.matchesWon);
+        leaderboards[LB_POINTS].set(index, player.totalPointsScored);
+        leaderboards[LB_RATING].set(index, player.rating);
+        if (player.matchesPlayed >= MIN_MATCHES_FOR_WIN_RATE) {
+            leaderboards[LB_WIN_RATE].set(index, player.winRate);
+        } else {
+            leaderboards[LB_WIN_RATE].erase(index);
+        }
+    }
+
+    static string formatLeaderboardScore(LeaderboardMetric metric, const PlayerStats& player) {
+        ostringstream out;
+        switch (metric) {
+            case LB_WINS: out << player.matchesWon << " wins"; break;
+            case LB_WIN_RATE: out << fixed << setprecision(2) << player.winRate * 100 << "%"; break;
+            case LB_POINTS: out << player.totalPointsScored << " points"; break;
+            default: out << fixed << setprecision(1) << player.rating; break;
+        }
+        return out.str();
+    }
+
+    // Find player in the stats table, adding them if they are new
+    PlayerStats* findOrCreatePlayer(const string& playerName) {
+        return &stats[stats.findOrCreate(playerName)];
+    }
+
+    // Append one match as a line of the log format
+    static void appendMatchLine(string& out, const MatchHistory* match) {
+        appendNumber(out, match->matchID);
+        out += ',';
+        out += match->player1;
+        out += ',';
+        out += match->player2;
+        out += ',';
+        appendNumber(out, match->score1);
+        out += ',';
+        appendNumber(out, match->score2);
+        out += ',';
+        out += match->winner;
+        out += ',';
+        out += match->stage;
+        out += ',';
+        out += match->date();
+        out += '\n';
+    }
+
+    // Queue a single record for the writer thread
+    void appendToLog(const MatchHistory* match) {
+        lock_guard<mutex> lock(writerMutex);
+        appendMatchLine(pendingLog, match);
+        // Wake the writer to start the commit window, or because the group is full
+        if (++pendingRecords == 1 || pendingRecords >= commitRecords) {
+            writerWake.notify_one();
+        }
+    }
+
+    // Copy the current statistics so they can be written without touching the live list
+    vector<PlayerStats> snapshotStats() {
+        return vector<PlayerStats>(stats.begin(), stats.end());
+    }
+
+    // Hand a copy of the statistics to the writer thread; a newer one replaces an unwritten one
+    void queueCheckpoint() {
+        PendingCheckpoint next{snapshotStats(), nextMatchID - 1};
+        {
+            lock_guard<mutex> lock(writerMutex);
+            checkpoint = move(next);
+            checkpointQueued = true;
+        }
+        recordsSinceCompaction = 0;
+        writerWake.notify_one();
+    }
+
+    // Block until the writer has written everything queued so far, or has failed to.
+    // Returns false if some lines are still waiting for a retry.
+    bool syncWriter() {
+        unique_lock<mutex> lock(writerMutex);
+        flushRequested = true;
+        writerWake.notify_one();
+        writerIdle.wait(lock, [this]() {
+            return !writerBusy && ((pendingRecords == 0 && !checkpointQueued) || writeFailed);
+        });
+        flushRequested = false;
+        return !writeFailed;
+    }
+
+    // The log was just rebuilt from the in-memory matches, so it already holds any
+    // lines the writer could not write
+    void dropUnwrittenLog() {
+        lock_guard<mutex> lock(writerMutex);
+        pendingLog.clear();
+        pendingRecords = 0;
+        writeFailed = false;
+        syncPending = false;
+    }
+
+    // Body of the writer thread
+    void writerLoop() {
+        unique_lock<mutex> lock(writerMutex);
+        while (true) {
+            writerWake.wait(lock, [this]() { return writerStop || pendingRecords > 0 || checkpointQueued; });
+            // Give more records the chance to join this commit
+            if (!writerStop && !flushRequested && !checkpointQueued && pendingRecords < commitRecords) {
+                writerWake.wait_for(lock, commitWindow, [this]() {
+                    return writerStop || flushRequested || pendingRecords >= commitRecords;
+                });
+            }
+            if (pendingRecords == 0 && !checkpointQueued) {
+                if (writerStop) break;
+                continue;
+            }
+
+            writeBuffer.swap(pendingLog);
+            pendingRecords = 0;
+            bool writeCheckpoint = checkpointQueued;
+            PendingCheckpoint rows;
+            if (writeCheckpoint) {
+                rows = move(checkpoint);
+                checkpointQueued = false;
+            }
+            writerBusy = true;
+            lock.unlock();
+
+            size_t written = 0;
+            bool logWritten = (writeBuffer.empty() && !syncPending) || commitLog(writeBuffer, written);
+            // The statistics must never count matches the log does not hold yet
+            if (writeCheckpoint && logWritten) {
+                writeStatsCheckpoint(rows.rows, rows.lastMatchID);
+            }
+
+            lock.lock();
+            writerBusy = false;
+            commitCount++;
+            writeFailed = !logWritten;
+            if (writeFailed) {
+                // Put what did not reach the file back in front of the lines queued since
+                if (written < writeBuffer.size()) {
+                    pendingLog.insert(0, writeBuffer, written, string::npos);
+                    // One line per record; a line cut off midway still counts as unwritten
+                    pendingRecords += static_cast<int>(count(writeBuffer.begin() + written, writeBuffer.end(), '\n'));
+                }
+                if (writeCheckpoint && !checkpointQueued) {
+                    checkpoint = move(rows);
+                    checkpointQueued = true;
+                }
+            }
+            writeBuffer.clear();
+            if ((pendingRecords == 0 && !checkpointQueued) || writeFailed) {
+                writerIdle.notify_all();
+            }
+            if (writeFailed) {
+                if (writerStop) {
+                    printLocked(to_string(pendingRecords) + " match(es) could not be written to " + MATCH_FILENAME + "!\n");
+                    break;
+                }
+                writerWake.wait_for(lock, WRITE_RETRY_DELAY, [this]() { return writerStop; });
+            }
+        }
+    }
+
+    // Append lines to the log with a single write, then flush (and fsync) them.
+    // Returns false on any failure; written is how many bytes reached the file.
+    bool commitLog(const string& lines, size_t& written) {
+        written = 0;
+        if (!matchLog) {
+            matchLog = fopen(MATCH_FILENAME.c_str(), "ab");
+            if (!matchLog) {
+                printLocked("Error opening " + MATCH_FILENAME + " for writing!\n");
+                return false;
+            }
+            setvbuf(matchLog, nullptr, _IONBF, 0); // So fwrite reports what reached the file
+        }
+        written = fwrite(lines.data(), 1, lines.size(), matchLog);
+        bool ok = written == lines.size() && fflush(matchLog) == 0;
+        if (ok && commitFsync) {
+#ifdef _WIN32
+            ok = _commit(_fileno(matchLog)) == 0;
+#else
+            ok = fsync(fileno(matchLog)) == 0;
+#endif
+            syncPending = !ok;
+        }
+        if (!ok) {
+            printLocked("Error writing " + MATCH_FILENAME + "! Unwritten matches will be retried.\n");
+            fclose(matchLog); // Reopened on the next attempt
+            matchLog = nullptr;
+        }
+        return ok;
+    }
+
+    // Replace target with the freshly written temp file
+    static bool replaceFile(const string& tempName, const string& target) {
+#ifdef _WIN32
+        remove(target.c_str()); // rename() does not overwrite on Windows
+#endif
+        return rename(tempName.c_str(), target.c_str()) == 0;
+    }
+
+    // Write the statistics file followed by the checkpoint line, then swap it in
+    void writeStatsCheckpoint(const vector<PlayerStats>& rows, int lastMatchID) {
+        string tempName = STATS_FILENAME + ".tmp";
+        ofstream statsFile(tempName);
+        if (!statsFile) {
+            return;
+        }
+
+        for (const PlayerStats& row : rows) {
+            statsFile << row.playerName << ","
+                      << row.matchesPlayed << ","
+                      << row.matchesWon << ","
+                      << row.totalPointsScored << ","
+                      << row.winRate << ","
+                      << row.rating << "\n";
+        }
+        statsFile << CHECKPOINT_PREFIX << lastMatchID << "\n";
+        statsFile.close();
+
+        replaceFile(tempName, STATS_FILENAME);
+    }
+
+    // Rewrite the whole match log in chronological order (used to convert old files)
+    bool rewriteMatchLog(const vector<MatchHistory*>& matches) {
+        string tempName = MATCH_FILENAME + ".tmp";
+        ofstream matchFile(tempName, ios::binary);
+        if (!matchFile) {
+            return false;
+        }
+        string lines;
+        for (const MatchHistory* match : matches) {
+            appendMatchLine(lines, match);
+        }
+        matchFile << lines;
+        matchFile.close();
+        return matchFile && replaceFile(tempName, MATCH_FILENAME);
+    }
+
+    // Load match history and stats from files
+    void loadFromFile(bool rebuildStats) {
+        vector<MatchHistory*> loaded;
+        bool chronological = true;
+
+        // Segments and the binary archive are only mapped, not parsed
+        segments.open(SEGMENT_PREFIX);
+        nextMatchID = segments.maxMatchID() + 1;
+        if (archive.open(ARCHIVE_FILENAME)) {
+            if (archive.size() > 0 && segments.segmentCount() > 0 && archive.minMatchID() <= segments.maxMatchID()) {
+                // Segments are always older than the archive, so this archive was sealed
+                // (or spilled) into the newest segment but not removed before a crash
+                LockedOutput out;
+                out << "Removing " << ARCHIVE_FILENAME << ", its matches are already in a segment." << endl;
+                archive.close();
+                remove(ARCHIVE_FILENAME.c_str());
+            } else {
+                nextMatchID = max(nextMatchID, archive.maxMatchID() + 1);
+            }
+        }
+
+        CsvBlockReader matchFile(MATCH_FILENAME);
+        if (matchFile.isOpen()) {
+            string_view line;
+            string_view tokens[8];
+            int maxID = nextMatchID - 1;
+
+            while (matchFile.nextLine(line)) {
+                size_t count = CsvBlockReader::splitFields(line, tokens, 8);
+                int id, s1, s2;
+
+                if (count >= 6 && CsvBlockReader::toInt(tokens[0], id) &&
+                    CsvBlockReader::toInt(tokens[3], s1) && CsvBlockReader::toInt(tokens[4], s2)) {
+                    if (archive.findRow(id) >= 0) {
+                        continue; // Already sealed into the archive
+                    }
+                    string_view stage = (count > 6) ? tokens[6] : string_view("Unknown");
+                    string_view date = (count > 7) ? tokens[7] : string_view();
+                    // "Unknown" is how a match without a date is written back
+                    if (!date.empty() && date != "Unknown" && dateToEpochDay(date) == INVALID_EPOCH_DAY) {
+                        LockedOutput out;
+                        out << "Skipping match " << id << " in " << MATCH_FILENAME << ": invalid date \""
+                            << date << "\" (expected YYYY-MM-DD)." << endl;
+                        continue;
+                    }
+
+                    if (!loaded.empty() && id < loaded.back()->matchID) {
+                        chronological = false;
+                    }
+                    loaded.push_back(new MatchHistory(id, string(tokens[1]), string(tokens[2]), s1, s2,
+                                                      string(tokens[5]), string(stage), date));
+
+                    if (id > maxID) maxID = id;
+                }
+            }
+
+            nextMatchID = maxID + 1;
+        }
+
+        // Drop lines a spill already moved into a segment; their blocks are decoded once
+        int firstCandidate = INT_MAX;
+        for (const MatchHistory* match : loaded) {
+            firstCandidate = min(firstCandidate, match->matchID);
+        }
+        if (firstCandidate <= segments.maxMatchID()) {
+            unordered_set<int> sealed;
+            segments.visitRange(firstCandidate, segments.maxMatchID(),
+                [&sealed](const MatchSegment&, const SegmentBlock& block, size_t row) {
+                    sealed.insert(block.columns[COL_ID][row]);
+                });
+            size_t kept = 0;
+            for (MatchHistory* match : loaded) {
+                if (sealed.count(match->matchID)) {
+                    delete match;
+                    staleLogLines++;
+                } else {
+                    loaded[kept++] = match;
+                }
+            }
+            loaded.resize(kept);
+        }
+
+        // Files written before the log format kept the newest match first
+        if (!chronological) {
+            stable_sort(loaded.begin(), loaded.end(), [](const MatchHistory* a, const MatchHistory* b) {
+                return a->matchID < b->matchID;
+            });
+            if (rewriteMatchLog(loaded)) {
+                staleLogLines = 0;
+            }
+        }
+
+        // Oldest is pushed first so the newest match ends up on top of the stack
+        for (MatchHistory* match : loaded) {
+            matchStack.pushFront(match);
+            indexMatch(match);
+        }
+
+        if (rebuildStats) {
+            rebuildStatsInParallel();
+            rebuildHeadToHead();
+            return;
+        }
+
+        // Load player statistics
+        bool statsFound = false;
+        int checkpointID = -1;
+        CsvBlockReader statsFile(STATS_FILENAME);
+        if (statsFile.isOpen()) {
+            string_view line;
+            string_view tokens[6];
+            statsFound = true;
+
+            while (statsFile.nextLine(line)) {
+                if (line.substr(0, CHECKPOINT_PREFIX.size()) == CHECKPOINT_PREFIX) {
+                    CsvBlockReader::toInt(line.substr(CHECKPOINT_PREFIX.size()), checkpointID);
+                    continue;
+                }
+
+                size_t count = CsvBlockReader::splitFields(line, tokens, 6);
+                int played, won, points;
+                double winRate;
+
+                if (count >= 5 && CsvBlockReader::toInt(tokens[1], played) && CsvBlockReader::toInt(tokens[2], won) &&
+                    CsvBlockReader::toInt(tokens[3], points) && CsvBlockReader::toDouble(tokens[4], winRate)) {
+                    PlayerStats& player = stats[stats.findOrCreate(tokens[0])];
+                    player.matchesPlayed = played;
+                    player.matchesWon = won;
+                    player.totalPointsScored = points;
+                    player.winRate = winRate;
+                    // Files written before ratings existed only have five columns
+                    if (count < 6 || !CsvBlockReader::toDouble(tokens[5], player.rating)) {
+                        player.rating = 1500.0;
+                    }
+                    updateLeaderboards(stats.indexOf(tokens[0]));
+                }
+            }
+        }
+
+        // Replay logged matches that are newer than the statistics checkpoint.
+        // Old stats files without a checkpoint line were always fully up to date.
+        if (!statsFound) {
+            checkpointID = 0;
+        }
+        if (checkpointID >= 0) {
+            if (checkpointID < segments.maxMatchID()) {
+                segments.visitRange(checkpointID + 1, INT_MAX,
+                    [this](const MatchSegment& segment, const SegmentBlock& block, size_t row) {
+                        applyMatchToStats(segment.readRow(block, row));
+                    });
+            }
+            if (checkpointID < archive.maxMatchID()) {
+                for (size_t row = 0; row < archive.size(); row++) {
+                    if (archive.value(COL_ID, row) > checkpointID) {
+                        applyMatchToStats(archive.readRow(row));
+                    }
+                }
+            }
+            for (MatchHistory* match : loaded) {
+                if (match->matchID > checkpointID) {
+                    applyMatchToStats(*match);
+                }
+            }
         }
 
-        avgPointsPerMatch = totalMatches > 0 ? static_cast<double>(totalPoints) / totalMatches : 0;
-
-        cout << "\n===== TOURNAMENT SUMMARY =====\n";
-        cout << "Total Matches Played: " << totalMatches << "\n";
-        cout << "Total Points Scored: " << totalPoints << "\n";
-        cout << "Average Points Per Match: " << fixed << setprecision(2) << avgPointsPerMatch << "\n\n";
-
-        cout << "Matches by Stage:\n";
-        for (const auto& stage : stageMatches) {
-            cout << "  " << stage.first << ": " << stage.second << " matches\n";
-        }
+        rebuildAggregates();
+        rebuildHeadToHead();
     }
+};
 
+// One MatchHistoryTracker per tournament or season ("shard"). The default shard uses
+// the plain file names; shard <name> keeps its history in <name>_match_history.txt,
+// <name>_player_stats.txt and so on. Shard names are listed in tournament_shards.txt.
+// A non-empty listPrefix is put in front of all of these file names.
+class MatchHistoryShards {
 private:
-    // Update or create player statistics
-    void updatePlayerStats(const string& playerName, int pointsScored, bool isWinner) {
-        PlayerStats* player = findOrCreatePlayer(playerName);
-
-        player->matchesPlayed++;
-        player->totalPointsScored += pointsScored;
-
-        if (isWinner) {
-            player->matchesWon++;
-        }
+    const string prefix;
+    const string SHARD_LIST_FILENAME;
+    vector<string> names;                              // names[0] is the default shard
+    vector<unique_ptr<MatchHistoryTracker>> trackers;  // Same order as names
+    size_t currentShard;
+
+    string filePrefix(const string& name) const {
+        return filePrefix(prefix, name);
+    }
 
-        // Update win rate
-        player->winRate = static_cast<double>(player->matchesWon) / player->matchesPlayed;
+    static string filePrefix(const string& listPrefix, const string& name) {
+        return name == DEFAULT_SHARD ? listPrefix : listPrefix + name + "_";
     }
 
-    // Find player in stats list
-    PlayerStats* findOrCreatePlayer(const string& playerName) {
-        // Check if player already exists
-        PlayerStats* temp = statsHead;
-        while (temp) {
-            if (temp->playerName == playerName) {
-                return temp;
+public:
+    static constexpr const char* DEFAULT_SHARD = "default";
+
+    // Load every listed shard, each on its own thread
+    MatchHistoryShards(bool rebuildStats = false, const string& listPrefix = "")
+        : prefix(listPrefix), SHARD_LIST_FILENAME(listPrefix + "tournament_shards.txt"), currentShard(0) {
+        names.push_back(DEFAULT_SHARD);
+        ifstream listFile(SHARD_LIST_FILENAME);
+        string name;
+        while (getline(listFile, name)) {
+            if (isValidName(name) && find(names.begin(), names.end(), name) == names.end()) {
+                names.push_back(name);
             }
-            temp = temp->next;
         }
 
-        PlayerStats* newPlayer = new PlayerStats(playerName);
-
-        if (!statsHead) {
-            statsHead = newPlayer;
-        } else {
-            newPlayer->next = statsHead;
-            statsHead = newPlayer;
+        auto started = chrono::steady_clock::now();
+        trackers.resize(names.size());
+        vector<thread> loaders;
+        for (size_t i = 0; i < names.size(); i++) {
+            loaders.emplace_back([this, i, rebuildStats]() {
+                trackers[i].reset(new MatchHistoryTracker(rebuildStats, filePrefix(names[i])));
+            });
+        }
+        for (thread& loader : loaders) {
+            loader.join();
+        }
+        if (names.size() > 1) {
+            double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            LockedOutput out;
+            out << names.size() << " tournament shard(s) loaded in " << fixed << setprecision(1)
+                << milliseconds << " ms." << endl;
         }
-
-        return newPlayer;
     }
 
-    // Save match history and stats to files
-    void saveToFile() {
-        ofstream matchFile(MATCH_FILENAME);
-        if (matchFile) {
-            MatchHistory* temp = top;
-            while (temp) {
-                matchFile << temp->matchID << ","
-                         << temp->player1 << ","
-                         << temp->player2 << ","
-                         << temp->score1 << ","
-                         << temp->score2 << ","
-                         << temp->winner << ","
-                         << temp->stage << ","
-                         << temp->date << "\n";
-                temp = temp->next;
-            }
-            matchFile.close();
+    // Letters, digits, '-' and '_' only, since the name becomes part of file names
+    static bool isValidName(const string& name) {
+        if (name.empty() || name.size() > 32) return false;
+        for (char c : name) {
+            if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') return false;
         }
+        return true;
+    }
 
-        // Save player statistics
-        ofstream statsFile(STATS_FILENAME);
-        if (statsFile) {
-            PlayerStats* temp = statsHead;
-            while (temp) {
-                statsFile << temp->playerName << ","
-                         << temp->matchesPlayed << ","
-                         << temp->matchesWon << ","
-                         << temp->totalPointsScored << ","
-                         << temp->winRate << "\n";
-                temp = temp->next;
+    // Every file the shards listed under listPrefix may have written, list included
+    static vector<string> dataFiles(const string& listPrefix) {
+        vector<string> files = MatchHistoryTracker::dataFiles(listPrefix);
+        string listFilename = listPrefix + "tournament_shards.txt";
+        ifstream listFile(listFilename);
+        string name;
+        while (getline(listFile, name)) {
+            if (isValidName(name) && name != DEFAULT_SHARD) {
+                for (const string& file : MatchHistoryTracker::dataFiles(filePrefix(listPrefix, name))) {
+                    files.push_back(file);
+                }
             }
-            statsFile.close();
         }
+        files.push_back(listFilename);
+        return files;
     }
 
-    // Load match history and stats from files
-    void loadFromFile() {
-        ifstream matchFile(MATCH_FILENAME);
-        if (matchFile) {
-            string line;
-            int maxID = 0;
-
-            while (getline(matchFile, line)) {
-                stringstream ss(line);
-                string token;
-                vector<string> tokens;
-
-                while (getline(ss, token, ',')) {
-                    tokens.push_back(token);
-                }
+    MatchHistoryTracker& current() { return *trackers[currentShard]; }
+    const string& currentName() const { return names[currentShard]; }
+    size_t shardCount() const { return trackers.size(); }
+    MatchHistoryTracker& shard(size_t index) { return *trackers[index]; }
+
+    // Make name the current shard, creating it (and adding it to the list) if it is new
+    bool select(const string& name) {
+        LockedOutput out;
+        auto it = find(names.begin(), names.end(), name);
+        if (it != names.end()) {
+            currentShard = it - names.begin();
+            return true;
+        }
+        if (!isValidName(name)) {
+            out << "Invalid shard name! Use letters, digits, '-' and '_' only." << endl;
+            return false;
+        }
+        ofstream listFile(SHARD_LIST_FILENAME, ios::app);
+        if (!(listFile << name << "\n")) {
+            out << "Error writing " << SHARD_LIST_FILENAME << "!" << endl;
+            return false;
+        }
+        names.push_back(name);
+        trackers.emplace_back(new MatchHistoryTracker(false, filePrefix(name)));
+        currentShard = names.size() - 1;
+        out << "Created tournament shard " << name << "." << endl;
+        return true;
+    }
 
-                if (tokens.size() >= 6) {
-                    int id = stoi(tokens[0]);
-                    string p1 = tokens[1];
-                    string p2 = tokens[2];
-                    int s1 = stoi(tokens[3]);
-                    int s2 = stoi(tokens[4]);
-                    string winner = tokens[5];
-                    string stage = (tokens.size() > 6) ? tokens[6] : "Unknown";
-                    string date = (tokens.size() > 7) ? tokens[7] : "";
+    void setHotWindow(int matches) {
+        for (auto& tracker : trackers) {
+            tracker->setHotWindow(matches);
+        }
+    }
 
-                    MatchHistory* newMatch = new MatchHistory(id, p1, p2, s1, s2, winner, stage, date);
-                    newMatch->next = top;
-                    top = newMatch;
+    void displayShards() {
+        LockedOutput out;
+        out << "\n===== TOURNAMENT SHARDS =====\n";
+        for (size_t i = 0; i < names.size(); i++) {
+            shared_ptr<const StatsView> view = trackers[i]->statsSnapshot();
+            out << (i == currentShard ? " * " : "   ") << setw(16) << left << names[i] << right
+                << view->playerCount << " player(s), last match ID " << view->lastMatchID << "\n";
+        }
+    }
 
-                    if (id > maxID) maxID = id;
+    // Career totals over every shard. Each shard's statistics are sorted by player
+    // name and the sorted runs are combined with a k-way merge, so one player's rows
+    // arrive together. The rating shown is the one from the last shard they played in.
+    // With playerName set, only that player is shown.
+    void displayCareerStats(const string& playerName = "") {
+        struct Run {
+            shared_ptr<const StatsView> view;  // Keeps the rows alive while they are merged
+            vector<const PlayerStats*> rows;   // Sorted by name
+            size_t next;
+        };
+        vector<Run> runs(trackers.size());
+        for (size_t i = 0; i < trackers.size(); i++) {
+            Run& run = runs[i];
+            run.view = trackers[i]->statsSnapshot();
+            run.next = 0;
+            for (size_t index = 0; index < run.view->playerCount; index++) {
+                const PlayerStats& player = run.view->player(index);
+                if (playerName.empty() || player.playerName == playerName) {
+                    run.rows.push_back(&player);
                 }
             }
-
-            nextMatchID = maxID + 1;
-            matchFile.close();
+            sort(run.rows.begin(), run.rows.end(), [](const PlayerStats* a, const PlayerStats* b) {
+                return a->playerName < b->playerName;
+            });
         }
 
-        // Load player statistics
-        ifstream statsFile(STATS_FILENAME);
-        if (statsFile) {
-            string line;
-
-            while (getline(statsFile, line)) {
-                stringstream ss(line);
-                string token;
-                vector<string> tokens;
-
-                while (getline(ss, token, ',')) {
-                    tokens.push_back(token);
+        // Min-heap of the next row of every run, ordered by name, then shard order
+        auto later = [&runs](size_t a, size_t b) {
+            const string& nameA = runs[a].rows[runs[a].next]->playerName;
+            const string& nameB = runs[b].rows[runs[b].next]->playerName;
+            return nameA != nameB ? nameA > nameB : a > b;
+        };
+        vector<size_t> heap;
+        for (size_t i = 0; i < runs.size(); i++) {
+            if (!runs[i].rows.empty()) heap.push_back(i);
+        }
+        make_heap(heap.begin(), heap.end(), later);
+
+        int shown = 0;
+        while (!heap.empty()) {
+            PlayerStats career(runs[heap.front()].rows[runs[heap.front()].next]->playerName);
+            int shards = 0;
+            while (!heap.empty() && runs[heap.front()].rows[runs[heap.front()].next]->playerName == career.playerName) {
+                pop_heap(heap.begin(), heap.end(), later);
+                Run& run = runs[heap.back()];
+                const PlayerStats& row = *run.rows[run.next++];
+                career.matchesPlayed += row.matchesPlayed;
+                career.matchesWon += row.matchesWon;
+                career.totalPointsScored += row.totalPointsScored;
+                career.rating = row.rating; // Runs are popped in shard order
+                shards++;
+                if (run.next < run.rows.size()) {
+                    push_heap(heap.begin(), heap.end(), later);
+                } else {
+                    heap.pop_back();
                 }
+            }
+            career.winRate = career.matchesPlayed ? static_cast<double>(career.matchesWon) / career.matchesPlayed : 0.0;
 
-                if (tokens.size() >= 5) {
-                    string name = tokens[0];
-                    PlayerStats* player = new PlayerStats(name);
-                    player->matchesPlayed = stoi(tokens[1]);
-                    player->matchesWon = stoi(tokens[2]);
-                    player->totalPointsScored = stoi(tokens[3]);
-                    player->winRate = stod(tokens[4]);
-
-                    player->next = statsHead;
-                    statsHead = player;
-                }
+            if (shown++ == 0) {
+                cout << "\n===== CAREER STATISTICS (" << trackers.size() << " shard(s)) =====\n";
+                cout << "+----------------+--------+----------------+----------------+----------------------+---------------+---------+\n";
+                cout << "|   Player Name  | Shards | Matches Played |  Matches Won   | Total Points Scored  |   Win Rate    | Rating  |\n";
+                cout << "+----------------+--------+----------------+----------------+----------------------+---------------+---------+\n";
             }
+            cout << "| " << setw(14) << career.playerName << " | "
+                 << setw(6) << shards << " | "
+                 << setw(14) << career.matchesPlayed << " | "
+                 << setw(14) << career.matchesWon << " | "
+                 << setw(20) << career.totalPointsScored << " | "
+                 << setw(11) << fixed << setprecision(2) << career.winRate * 100 << "% | "
+                 << setw(7) << setprecision(1) << career.rating << " |\n";
+        }
 
-            statsFile.close();
+        if (shown == 0) {
+            if (playerName.empty()) {
+                cout << "No player statistics available." << endl;
+            } else {
+                cout << "No statistics found for player " << playerName << "." << endl;
+            }
+        } else {
+            cout << "+----------------+--------+----------------+----------------+----------------------+---------------+---------+\n";
         }
     }
 };
 
-void handleMatchHistoryMenu(MatchHistoryTracker &tracker) {
+// Function to read a YYYY-MM-DD date, returned as an epoch day
+int32_t getValidatedDate(const string& prompt) {
+    string input;
+    while (true) {
+        cout << prompt;
+        getline(cin, input);
+        int32_t day = dateToEpochDay(input);
+        if (day != INVALID_EPOCH_DAY) {
+            return day;
+        }
+        cout << "Invalid date! Please use the format YYYY-MM-DD.\n";
+    }
+}
+
+void handleMatchHistoryMenu(MatchHistoryShards &shards) {
     int choice;
     while (true) {
-        cout << "\n===== MATCH HISTORY TRACKING =====\n";
+        saveSnapshotIfDue();
+        MatchHistoryTracker &tracker = shards.current();
+        cout << "\n===== MATCH HISTORY TRACKING (" << shards.currentName() << ") =====\n";
         cout << "1. Record a Match Result\n";
         cout << "2. Display Match History\n";
         cout << "3. Search Match by Match ID\n";
@@ -1865,11 +6315,24 @@ void handleMatchHistoryMenu(MatchHistoryTracker &tracker) {
         cout << "5. Display Player Statistics\n";
         cout << "6. Show Top Performers\n";
         cout << "7. Generate Tournament Summary\n";
-        cout << "8. Return to Main Menu\n";
+        cout << "8. Archive Match History to Binary File\n";
+        cout << "9. Search Matches by ID Range\n";
+        cout << "10. Show Leaderboard\n";
+        cout << "11. Show Player Rankings\n";
+        cout << "12. Search Matches by Date Range\n";
+        cout << "13. Daily and Weekly Report\n";
+        cout << "14. Export Status\n";
+        cout << "15. Head-to-Head Record\n";
+        cout << "16. Rivalry Report\n";
+        cout << "17. Compress Archive into Segment\n";
+        cout << "18. Set In-Memory Match Window\n";
+        cout << "19. Switch Tournament Shard\n";
+        cout << "20. Career Statistics Across Shards\n";
+        cout << "21. Return to Main Menu\n";
         cout << "\nEnter your choice: ";
-        choice = getValidatedInput(1, 8);
+        choice = getValidatedInput(1, 21);
 
-        if (choice == 8) break;
+        if (choice == 21) break;
 
         switch (choice) {
             case 1: {
@@ -1913,9 +6376,14 @@ void handleMatchHistoryMenu(MatchHistoryTracker &tracker) {
                 tracker.searchMatchByID(matchID);
                 break;
             }
-            case 4:
-                tracker.exportMatchHistory();
+            case 4: {
+                cout << "Format (1 = CSV, 2 = NDJSON): ";
+                int format = getValidatedInput(1, 2);
+                cout << "Rows (1 = All matches, 2 = Only matches added since the last export): ";
+                int rows = getValidatedInput(1, 2);
+                tracker.exportMatchHistory(static_cast<ExportFormat>(format - 1), rows == 2);
                 break;
+            }
             case 5:
                 tracker.displayPlayerStats();
                 break;
@@ -1925,6 +6393,91 @@ void handleMatchHistoryMenu(MatchHistoryTracker &tracker) {
             case 7:
                 tracker.generateTournamentSummary();
                 break;
+            case 8:
+                tracker.archiveMatchHistory();
+                break;
+            case 9: {
+                int firstID, lastID;
+                cout << "Enter first Match ID: ";
+                cin >> firstID;
+                cout << "Enter last Match ID: ";
+                cin >> lastID;
+                tracker.displayMatchRange(firstID, lastID);
+                break;
+            }
+            case 10: {
+                cout << "Leaderboard (1 = Most Wins, 2 = Win Rate, 3 = Total Points, 4 = Rating): ";
+                int metric = getValidatedInput(1, 4);
+                cout << "How many players to show: ";
+                int count = getValidatedInput(1, numeric_limits<int>::max());
+                tracker.displayLeaderboard(static_cast<LeaderboardMetric>(metric - 1), count);
+                break;
+            }
+            case 11: {
+                string playerName;
+                cout << "Enter Player Name: ";
+                getline(cin, playerName);
+                tracker.displayPlayerRank(playerName);
+                break;
+            }
+            case 12:
+            case 13: {
+                int32_t firstDay = getValidatedDate("Enter start date (YYYY-MM-DD): ");
+                int32_t lastDay = getValidatedDate("Enter end date (YYYY-MM-DD): ");
+                if (choice == 12) {
+                    tracker.displayMatchesByDate(firstDay, lastDay);
+                } else {
+                    tracker.displayDailyReport(firstDay, lastDay);
+                }
+                break;
+            }
+            case 14:
+                tracker.displayExportStatus();
+                break;
+            case 15: {
+                string playerA, playerB;
+                cout << "Enter first Player Name: ";
+                getline(cin, playerA);
+                cout << "Enter second Player Name: ";
+                getline(cin, playerB);
+                tracker.displayHeadToHead(playerA, playerB);
+                break;
+            }
+            case 16: {
+                string playerName;
+                cout << "Enter Player Name: ";
+                getline(cin, playerName);
+                cout << "How many opponents to show: ";
+                int count = getValidatedInput(1, numeric_limits<int>::max());
+                tracker.displayRivalries(playerName, count);
+                break;
+            }
+            case 17:
+                tracker.sealArchiveToSegment();
+                break;
+            case 18: {
+                cout << "Matches to keep in memory (0 = all): ";
+                int matches = getValidatedInput(0, numeric_limits<int>::max());
+                tracker.setHotWindow(matches);
+                break;
+            }
+            case 19: {
+                shards.displayShards();
+                string name;
+                cout << "Enter shard name (a new name creates a shard): ";
+                getline(cin, name);
+                if (shards.select(name)) {
+                    cout << "Now tracking " << shards.currentName() << "." << endl;
+                }
+                break;
+            }
+            case 20: {
+                string playerName;
+                cout << "Enter Player Name (leave empty for everyone): ";
+                getline(cin, playerName);
+                shards.displayCareerStats(playerName);
+                break;
+            }
             default:
                 cout << "Invalid choice! Try again.";
                 break;
@@ -1932,23 +6485,976 @@ void handleMatchHistoryMenu(MatchHistoryTracker &tracker) {
     }
 }
 
+// Swallows everything written to it
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// --benchmark-recording [n]: time recordMatch under different group commit settings.
+// Uses its own benchmark_* files, which are removed afterwards.
+void runRecordingBenchmark(int records) {
+    struct Setting {
+        const char* name;
+        int groupRecords;
+        int windowMicros;
+        bool fsync;
+    };
+    const Setting settings[] = {
+        {"group commit 64 records / 5 ms, no fsync", 64, 5000, false},
+        {"group commit 64 records / 5 ms, fsync", 64, 5000, true},
+        {"commit without waiting, fsync", 1, 0, true},
+    };
+    const string prefix = "benchmark_";
+    auto removeFiles = [&prefix]() {
+        remove((prefix + "match_history.txt").c_str());
+        remove((prefix + "player_stats.txt").c_str());
+    };
+
+    cout << "Recording " << records << " matches per setting\n";
+    for (const Setting& setting : settings) {
+        removeFiles();
+        vector<double> latencies;
+        latencies.reserve(records);
+        double flushMicros;
+        size_t commits;
+        {
+            MatchHistoryTracker tracker(false, prefix);
+            tracker.setGroupCommit(setting.groupRecords, chrono::microseconds(setting.windowMicros), setting.fsync);
+
+            NullBuffer sink;
+            streambuf* console = cout.rdbuf(&sink);
+            auto started = chrono::steady_clock::now();
+            for (int i = 0; i < records; i++) {
+                auto before = chrono::steady_clock::now();
+                tracker.recordMatch("Player" + to_string(i % 64), "Player" + to_string((i * 7 + 1) % 64),
+                                    i % 11, (i * 3) % 11, "Round Robin");
+                latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - before).count());
+            }
+            tracker.flushLog();
+            flushMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count();
+            commits = tracker.commits();
+            cout.rdbuf(console);
+        }
+        removeFiles();
+
+        sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) {
+            return latencies[min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+        };
+        cout << setting.name << ":\n" << fixed << setprecision(2)
+             << "  recordMatch latency p50 " << percentile(0.50) << " us, p99 " << percentile(0.99)
+             << " us, max " << latencies.back() << " us\n"
+             << "  " << records << (setting.fsync ? " matches durable in " : " matches written, not fsynced, in ")
+             << flushMicros / 1000 << " ms ("
+             << setprecision(0) << records / (flushMicros / 1e6) << " matches/s, " << commits << " commits)\n";
+    }
+}
+
+// --benchmark-readers: statistics reads per second with 1, 2, 4, ... reader threads
+// while another thread keeps recording matches. Each read takes the published view
+// and scans every player, as a display board refresh would.
+void runReaderBenchmark() {
+    const string prefix = "benchmark_";
+    auto removeFiles = [&prefix]() {
+        remove((prefix + "match_history.txt").c_str());
+        remove((prefix + "player_stats.txt").c_str());
+    };
+    const chrono::milliseconds phase(500);
+    unsigned maxReaders = max(thread::hardware_concurrency(), 1u);
+
+    removeFiles();
+    ostringstream report;
+    {
+        MatchHistoryTracker tracker(false, prefix);
+        NullBuffer sink;
+        streambuf* console = cout.rdbuf(&sink); // Restored once the recording thread is done
+
+        atomic<bool> stopRecording(false);
+        atomic<long> recorded(0);
+        thread recorder([&]() {
+            for (int i = 0; !stopRecording; i++) {
+                tracker.recordMatch("Player" + to_string(i % 64), "Player" + to_string((i * 7 + 1) % 64),
+                                    i % 11, (i * 3) % 11, "Round Robin");
+                recorded++;
+            }
+        });
+
+        for (unsigned readers = 1; readers <= maxReaders; readers *= 2) {
+            atomic<bool> stopReading(false);
+            vector<long> reads(readers, 0);
+            vector<long> checksums(readers, 0); // Written out so the scan is not optimized away
+            vector<thread> threads;
+            long recordedBefore = recorded;
+            for (unsigned r = 0; r < readers; r++) {
+                threads.emplace_back([&, r]() {
+                    long count = 0, checksum = 0;
+                    while (!stopReading) {
+                        shared_ptr<const StatsView> view = tracker.statsSnapshot();
+                        for (size_t index = 0; index < view->playerCount; index++) {
+                            checksum += view->player(index).matchesWon;
+                        }
+                        count++;
+                    }
+                    reads[r] = count;
+                    checksums[r] = checksum;
+                });
+            }
+            this_thread::sleep_for(phase);
+            stopReading = true;
+            for (thread& reader : threads) {
+                reader.join();
+            }
+
+            long total = 0;
+            for (long count : reads) total += count;
+            double seconds = chrono::duration<double>(phase).count();
+            report << setw(3) << readers << " reader(s): " << fixed << setprecision(0)
+                   << total / seconds << " reads/s (" << total / seconds / readers << " per reader), "
+                   << (recorded - recordedBefore) / seconds << " matches/s recorded\n";
+        }
+
+        stopRecording = true;
+        recorder.join();
+        cout.rdbuf(console);
+    }
+    removeFiles();
+    cout << "Reading player statistics while recording matches\n" << report.str();
+}
+
+const string APP_SNAPSHOT_FILENAME = "app_snapshot.bin";
+
+// Write every subsystem into app_snapshot.bin. Match history is not included: it
+// already keeps its own append-only log and statistics checkpoint.
+void saveApplicationSnapshot(SpectatorManager& manager, PriorityQueue& entranceQueue, PriorityQueue& exitQueue,
+                             WithdrawalQueue& withdrawalQueue, TournamentScheduler& tournament,
+                             WinnerList& winnersList, WinnerList& knockoutPlayers) {
+    auto started = chrono::steady_clock::now();
+    SnapshotWriter out;
+    out.beginSection(SNAP_SPECTATORS);
+    manager.saveSnapshot(out);
+    out.beginSection(SNAP_ENTRANCE_QUEUE);
+    entranceQueue.saveSnapshot(out);
+    out.beginSection(SNAP_EXIT_QUEUE);
+    exitQueue.saveSnapshot(out);
+    out.beginSection(SNAP_SCHEDULE);
+    tournament.saveSnapshot(out);
+    out.beginSection(SNAP_WINNERS);
+    winnersList.saveSnapshot(out);
+    out.beginSection(SNAP_KNOCKOUT_PLAYERS);
+    knockoutPlayers.saveSnapshot(out);
+    out.beginSection(SNAP_WITHDRAWALS);
+    withdrawalQueue.saveSnapshot(out);
+
+    if (!out.save(APP_SNAPSHOT_FILENAME)) {
+        cout << "Error writing " << APP_SNAPSHOT_FILENAME << "!" << endl;
+        return;
+    }
+    lastSnapshotSave = chrono::steady_clock::now();
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    cout << "Snapshot saved to " << APP_SNAPSHOT_FILENAME << " in " << fixed << setprecision(1)
+         << milliseconds << " ms." << endl;
+}
+
+// Restore every subsystem from app_snapshot.bin, if there is one. Called on startup
+// while everything is still empty.
+void loadApplicationSnapshot(SpectatorManager& manager, PriorityQueue& entranceQueue, PriorityQueue& exitQueue,
+                             WithdrawalQueue& withdrawalQueue, TournamentScheduler& tournament,
+                             WinnerList& winnersList, WinnerList& knockoutPlayers) {
+    auto started = chrono::steady_clock::now();
+    SnapshotReader snapshot;
+    if (!snapshot.open(APP_SNAPSHOT_FILENAME)) {
+        return;
+    }
+
+    bool ok = true;
+    auto load = [&](SnapshotSection section, auto& subsystem) {
+        SnapshotReader::Cursor in = snapshot.section(section);
+        subsystem.loadSnapshot(in);
+        ok = ok && in.good();
+    };
+    load(SNAP_SPECTATORS, manager);
+    load(SNAP_ENTRANCE_QUEUE, entranceQueue);
+    load(SNAP_EXIT_QUEUE, exitQueue);
+    load(SNAP_SCHEDULE, tournament);
+    load(SNAP_WINNERS, winnersList);
+    load(SNAP_KNOCKOUT_PLAYERS, knockoutPlayers);
+    load(SNAP_WITHDRAWALS, withdrawalQueue);
+
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    if (!ok) {
+        cout << "Warning: " << APP_SNAPSHOT_FILENAME << " is incomplete; some state may be missing." << endl;
+    }
+    cout << "Restored snapshot from " << APP_SNAPSHOT_FILENAME << " in " << fixed << setprecision(1)
+         << milliseconds << " ms." << endl;
+}
+
+
+// Collects everything written to cout and writes it to stdout in large pieces.
+// endl and flush do not force a write; writeOut() does.
+class BatchOutputBuffer : public streambuf {
+private:
+    static const size_t WRITE_SIZE = 1 << 20; // Written early if a batch prints more than this
+    string pending;
+
+protected:
+    int overflow(int c) override {
+        if (c != EOF) {
+            pending += static_cast<char>(c);
+            if (pending.size() >= WRITE_SIZE) writeOut();
+        }
+        return c;
+    }
+
+    streamsize xsputn(const char* text, streamsize count) override {
+        pending.append(text, count);
+        if (pending.size() >= WRITE_SIZE) writeOut();
+        return count;
+    }
+
+    int sync() override {
+        return 0;
+    }
+
+public:
+    void writeOut() {
+        fwrite(pending.data(), 1, pending.size(), stdout);
+        fflush(stdout);
+        pending.clear();
+    }
+};
+
+// --headless [file]: run commands from a file, or stdin, instead of the menus. One
+// command per line, its arguments separated by commas like the data files:
+//
+//   register,<name>,<priority 0-2>[,<time>]   search-spectator,<id>   spectators
+//   queue-entrance   admit   leave-entrance,<id>   queue-exit   release   leave-exit,<id>
+//   schedule,<player 1>,<player 2>,<stage>   show-schedule   winner,<name>   winners
+//   withdraw,<player>[,<substitute>]   process-withdrawal   process-withdrawals   withdrawals
+//   record,<player 1>,<player 2>,<score 1>,<score 2>[,<stage>]   match,<id>
+//   matches,<first id>,<last id>   stats   top   summary   rank,<player>
+//   leaderboard,<1-4>,<count>   head-to-head,<player>,<player>   career[,<player>]
+//   shard,<name>   archive   snapshot   flush   profile   profile-json   profile-reset
+//
+// Empty lines and lines starting with '#' are skipped. Output is collected and
+// written once every COMMAND_BATCH commands, so a recorded day of operations replays
+// without waiting on the terminal. The snapshot is only saved by the snapshot command.
+// A timed run discards the output instead and records how long every command took.
+class HeadlessDriver {
+private:
+    static const int COMMAND_BATCH = 4096;
+    static const size_t MAX_FIELDS = 8;
+    SpectatorManager& manager;
+    PriorityQueue& entranceQueue;
+    PriorityQueue& exitQueue;
+    WithdrawalQueue& withdrawalQueue;
+    TournamentScheduler& tournament;
+    WinnerList& winnersList;
+    WinnerList& knockoutPlayers;
+    MatchHistoryShards& shards;
+    map<string, vector<double>, less<>> latencies; // Microseconds per call, by command name
+
+    // Run one command; false if it is unknown or its arguments are invalid
+    bool execute(const string_view* fields, size_t count) {
+        string_view command = fields[0];
+        auto text = [&](size_t i) { return string(fields[i]); };
+        auto number = [&](size_t i, int& value) { return i < count && CsvBlockReader::toInt(fields[i], value); };
+        MatchHistoryTracker& tracker = shards.current();
+        int a, b;
+
+        if (command == "register" && count >= 3 && number(2, a) && a >= 0 && a <= 2) {
+            if (a == 1 && manager.getEarlyBirdCount() >= EARLY_BIRD_SLOTS) {
+                cout << "Early-bird registrations are full.\n";
+                return false;
+            }
+            manager.registerSpectator(text(1), a, count > 3 ? text(3) : getCurrentTime());
+            cout << "Spectator ID: " << manager.getIDCounter() - 1 << ", Name: " << fields[1] << " registered.\n";
+        } else if (command == "search-spectator" && number(1, a)) {
+            manager.searchSpectator(a);
+        } else if (command == "spectators") {
+            manager.displayAll();
+        } else if (command == "queue-entrance") {
+            showEntranceQueue(manager, entranceQueue);
+        } else if (command == "admit") {
+            admitEntranceQueue(manager, entranceQueue);
+        } else if (command == "queue-exit") {
+            showExitQueue(manager, exitQueue);
+        } else if (command == "release") {
+            releaseExitQueue(manager, exitQueue);
+        } else if (command == "leave-entrance" && number(1, a)) {
+            return leaveEntranceQueue(manager, entranceQueue, a);
+        } else if (command == "leave-exit" && number(1, a)) {
+            return leaveExitQueue(exitQueue, a);
+        } else if (command == "schedule" && count >= 4) {
+            tournament.enqueue(text(1), text(2), text(3));
+        } else if (command == "show-schedule") {
+            tournament.display();
+        } else if (command == "winner" && count >= 2) {
+            winnersList.addWinner(text(1));
+        } else if (command == "winners") {
+            winnersList.display();
+        } else if (command == "withdraw" && count >= 2) {
+            withdrawalQueue.enqueueWithdrawal(text(1), count > 2 ? text(2) : "");
+        } else if (command == "process-withdrawal") {
+            withdrawalQueue.processWithdrawal(tournament);
+        } else if (command == "process-withdrawals") {
+            withdrawalQueue.processAllWithdrawals(tournament);
+        } else if (command == "withdrawals") {
+            withdrawalQueue.displayAllWithdrawals();
+        } else if (command == "record" && count >= 5 && number(3, a) && number(4, b) && a >= 0 && b >= 0) {
+            tracker.recordMatch(text(1), text(2), a, b, count > 5 ? text(5) : "Unknown");
+        } else if (command == "match" && number(1, a)) {
+            tracker.searchMatchByID(a);
+        } else if (command == "matches" && number(1, a) && number(2, b)) {
+            tracker.displayMatchRange(a, b);
+        } else if (command == "stats") {
+            tracker.displayPlayerStats();
+        } else if (command == "top") {
+            tracker.displayTopPerformers();
+        } else if (command == "summary") {
+            tracker.generateTournamentSummary();
+        } else if (command == "rank" && count >= 2) {
+            tracker.displayPlayerRank(text(1));
+        } else if (command == "leaderboard" && number(1, a) && number(2, b) && a >= 1 && a <= LB_COUNT && b >= 1) {
+            tracker.displayLeaderboard(static_cast<LeaderboardMetric>(a - 1), b);
+        } else if (command == "head-to-head" && count >= 3) {
+            tracker.displayHeadToHead(text(1), text(2));
+        } else if (command == "career") {
+            shards.displayCareerStats(count > 1 ? text(1) : "");
+        } else if (command == "shard" && count >= 2) {
+            return shards.select(text(1));
+        } else if (command == "archive") {
+            tracker.archiveMatchHistory();
+        } else if (command == "snapshot") {
+            saveApplicationSnapshot(manager, entranceQueue, exitQueue, withdrawalQueue, tournament,
+                                    winnersList, knockoutPlayers);
+        } else if (command == "profile") {
+            displayProbeStats();
+        } else if (command == "profile-json") {
+            writeProbeStatsJson(cout);
+        } else if (command == "profile-reset") {
+            resetProbeStats();
+        } else if (command != "flush") {
+            return false;
+        }
+        return true;
+    }
+
+public:
+    HeadlessDriver(SpectatorManager& manager, PriorityQueue& entranceQueue, PriorityQueue& exitQueue,
+                   WithdrawalQueue& withdrawalQueue, TournamentScheduler& tournament,
+                   WinnerList& winnersList, WinnerList& knockoutPlayers, MatchHistoryShards& shards)
+        : manager(manager), entranceQueue(entranceQueue), exitQueue(exitQueue), withdrawalQueue(withdrawalQueue),
+          tournament(tournament), winnersList(winnersList), knockoutPlayers(knockoutPlayers), shards(shards) {}
+
+    // Run every command in filename (stdin if empty); returns the number of failed commands.
+    // With timed set, output is discarded and failures are reported on cerr.
+    int run(const string& filename, bool timed = false) {
+        unique_ptr<CsvBlockReader> input(filename.empty() ? new CsvBlockReader(stdin) : new CsvBlockReader(filename));
+        if (!input->isOpen()) {
+            cerr << "Error opening " << filename << "!" << endl;
+            return 1;
+        }
+
+        BatchOutputBuffer output;
+        NullBuffer discarded;
+        streambuf* console = cout.rdbuf(timed ? static_cast<streambuf*>(&discarded) : &output);
+        auto started = chrono::steady_clock::now();
+        string_view line;
+        string_view fields[MAX_FIELDS];
+        long lineNumber = 0, commands = 0;
+        int failed = 0;
+
+        while (input->nextLine(line)) {
+            lineNumber++;
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            size_t count = CsvBlockReader::splitFields(line, fields, MAX_FIELDS);
+            bool ok;
+            if (timed) {
+                auto before = chrono::steady_clock::now();
+                ok = execute(fields, count);
+                double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - before).count();
+                auto entry = latencies.find(fields[0]);
+                if (entry == latencies.end()) {
+                    entry = latencies.emplace(string(fields[0]), vector<double>()).first;
+                }
+                entry->second.push_back(micros);
+            } else {
+                ok = execute(fields, count);
+            }
+            if (!ok) {
+                (timed ? cerr : cout) << "Line " << lineNumber << ": could not run \"" << line << "\"\n";
+                failed++;
+            }
+            if (++commands % COMMAND_BATCH == 0 || fields[0] == "flush") {
+                output.writeOut();
+            }
+        }
+
+        output.writeOut();
+        cout.rdbuf(console);
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        cerr << commands << " command(s), " << failed << " failed, in " << fixed << setprecision(1) << milliseconds
+             << " ms (" << setprecision(0) << commands / max(milliseconds / 1000, 1e-9) << " commands/s)." << endl;
+        return failed;
+    }
+
+    // Throughput and latency percentiles of every command seen by a timed run
+    void displayLatencyReport() {
+        cout << "\n===== REPLAY LATENCY BY COMMAND (microseconds) =====\n";
+        cout << setw(20) << left << "Command" << right << setw(9) << "Count" << setw(12) << "Ops/s"
+             << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(12) << "Max" << "\n";
+        for (auto& entry : latencies) {
+            vector<double>& samples = entry.second;
+            sort(samples.begin(), samples.end());
+            double total = 0;
+            for (double sample : samples) {
+                total += sample;
+            }
+            auto percentile = [&samples](double fraction) {
+                return samples[min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))];
+            };
+            cout << setw(20) << left << entry.first << right << setw(9) << samples.size() << fixed
+                 << setprecision(0) << setw(12) << samples.size() / max(total / 1e6, 1e-9) << setprecision(1)
+                 << setw(10) << percentile(0.50) << setw(10) << percentile(0.90) << setw(10) << percentile(0.99)
+                 << setw(12) << samples.back() << "\n";
+        }
+    }
+};
+
+const int WORKLOAD_BURST = 500; // Average number of tickets sold per burst
+
+// Name of the knockout round that starts with the given number of players
+string bracketStage(size_t players) {
+    if (players == 2) return "Final";
+    if (players == 4) return "Semifinal";
+    if (players == 8) return "Quarterfinal";
+    return "Round of " + to_string(players);
+}
+
+// --generate-workload <file> [spectators] [bracket size] [seed]: write a synthetic day of
+// operations for --headless or --replay-workload. Tickets sell in bursts (about 8% VIP,
+// the Early-bird slots, the rest Normal) and each burst is followed by a gate wave in
+// which a few spectators give up and leave. A knockout bracket of qualifiers is played
+// alongside, with withdrawals, some with substitutes, before every round. At the end of
+// the day everyone heads for the exit and a few leave the exit queue early. Spectator IDs
+// assume fresh subsystems, and the same seed always writes the same file.
+bool generateWorkload(const string& filename, int spectators, int bracketSize, unsigned seed) {
+    ofstream out(filename, ios::binary);
+    if (!out) {
+        cout << "Error opening " << filename << "!" << endl;
+        return false;
+    }
+    mt19937 random(seed);
+    auto pick = [&random](int low, int high) { return uniform_int_distribution<int>(low, high)(random); };
+    auto chance = [&random](double probability) { return uniform_real_distribution<double>(0, 1)(random) < probability; };
+    out << "# Synthetic workload: " << spectators << " spectators, " << bracketSize << "-player bracket, seed "
+        << seed << "\n";
+
+    // Every round of the bracket is two steps: scheduling (with withdrawals), then playing
+    vector<string> bracket;
+    for (int i = 1; i <= bracketSize; i++) {
+        bracket.push_back("Qualifier" + to_string(i));
+    }
+    vector<pair<string, string>> pairs;
+    vector<int> absentSide; // Per pair: -1, or the side that withdrew without a substitute
+    string stage;
+    int step = 0, totalSteps = 0, substitutes = 0;
+    for (int players = bracketSize; players > 1; players /= 2) {
+        totalSteps += 2;
+    }
+    auto tournamentStep = [&]() {
+        if (step++ % 2 == 0) {
+            stage = bracketStage(bracket.size());
+            pairs.clear();
+            absentSide.clear();
+            for (size_t i = 0; i + 1 < bracket.size(); i += 2) {
+                out << "schedule," << bracket[i] << "," << bracket[i + 1] << "," << stage << "\n";
+                pairs.emplace_back(bracket[i], bracket[i + 1]);
+                absentSide.push_back(-1);
+            }
+            for (size_t m = 0; m < pairs.size(); m++) {
+                if (!chance(0.05)) continue;
+                int side = pick(0, 1);
+                string& player = side ? pairs[m].second : pairs[m].first;
+                if (chance(0.6)) {
+                    string substitute = "Substitute" + to_string(++substitutes);
+                    out << "withdraw," << player << "," << substitute << "\n";
+                    player = substitute;
+                } else {
+                    out << "withdraw," << player << "\n";
+                    absentSide[m] = side;
+                }
+            }
+            return;
+        }
+        out << "process-withdrawals\n";
+        bracket.clear();
+        for (size_t m = 0; m < pairs.size(); m++) {
+            int score1 = 3, score2 = 0; // Walkover when a player withdrew without a substitute
+            if (absentSide[m] == 0) {
+                swap(score1, score2);
+            } else if (absentSide[m] == -1) {
+                score1 = pick(0, 5);
+                do {
+                    score2 = pick(0, 5);
+                } while (score2 == score1);
+            }
+            const string& winner = score1 > score2 ? pairs[m].first : pairs[m].second;
+            out << "record," << pairs[m].first << "," << pairs[m].second << "," << score1 << "," << score2 << ","
+                << stage << "\n";
+            out << "winner," << winner << "\n";
+            bracket.push_back(winner);
+        }
+        out << "top\n";
+    };
+
+    int nextID = 1, earlyBirds = 0, seconds = 8 * 3600, bursts = 0;
+    int expectedBursts = max(1, spectators / WORKLOAD_BURST);
+    vector<int> waiting, inside;
+    char clock[16];
+    while (nextID <= spectators) {
+        // Ticket sales
+        int burst = min(spectators - nextID + 1, pick(WORKLOAD_BURST / 2, WORKLOAD_BURST * 3 / 2));
+        for (int i = 0; i < burst; i++) {
+            int priority = chance(0.08) ? 0 : (earlyBirds < EARLY_BIRD_SLOTS && chance(0.1)) ? 1 : 2;
+            earlyBirds += priority == 1;
+            seconds = min(seconds + pick(0, 2), 24 * 3600 - 1);
+            snprintf(clock, sizeof(clock), "%02d:%02d:%02d", seconds / 3600, seconds / 60 % 60, seconds % 60);
+            out << "register,Spectator" << nextID << "," << priority << "," << clock << "\n";
+            waiting.push_back(nextID++);
+        }
+
+        // Gate wave: everyone waiting queues up, about 2% give up, the rest are let in
+        out << "queue-entrance\n";
+        for (int leavers = pick(0, static_cast<int>(waiting.size()) / 25); leavers > 0; leavers--) {
+            size_t index = pick(0, static_cast<int>(waiting.size()) - 1);
+            out << "leave-entrance," << waiting[index] << "\n";
+            waiting[index] = waiting.back();
+            waiting.pop_back();
+        }
+        out << "admit\n";
+        inside.insert(inside.end(), waiting.begin(), waiting.end());
+        waiting.clear();
+
+        // The odd lookup between bursts
+        switch (pick(0, 9)) {
+            case 0: out << "stats\n"; break;
+            case 1: out << "leaderboard," << pick(1, LB_COUNT) << ",10\n"; break;
+            case 2: out << "search-spectator," << pick(1, nextID - 1) << "\n"; break;
+            default: break;
+        }
+
+        bursts++;
+        while (step < totalSteps && static_cast<long>(step) * expectedBursts < static_cast<long>(bursts) * totalSteps) {
+            tournamentStep();
+        }
+    }
+    while (step < totalSteps) {
+        tournamentStep();
+    }
+
+    // End of the day
+    if (!inside.empty()) {
+        out << "queue-exit\n";
+        for (int leavers = pick(0, static_cast<int>(inside.size()) / 100); leavers > 0; leavers--) {
+            size_t index = pick(0, static_cast<int>(inside.size()) - 1);
+            out << "leave-exit," << inside[index] << "\n";
+            inside[index] = inside.back();
+            inside.pop_back();
+        }
+        out << "release\n";
+    }
+    out << "summary\ncareer\n";
+    out.close();
+    if (out.fail()) {
+        cout << "Error writing " << filename << "!" << endl;
+        return false;
+    }
+    cout << "Workload written to " << filename << "." << endl;
+    return true;
+}
+
+// --replay-workload <file>: run a workload through fresh subsystems and report the
+// throughput and latency of every command. Match history goes to workload_* files,
+// which are removed afterwards; the application snapshot is neither loaded nor saved.
+int replayWorkload(const string& filename) {
+    const string prefix = "workload_";
+    for (const string& file : MatchHistoryShards::dataFiles(prefix)) {
+        remove(file.c_str());
+    }
+
+    int failed;
+    {
+        SpectatorManager manager;
+        PriorityQueue entranceQueue, exitQueue;
+        WithdrawalQueue withdrawalQueue(numeric_limits<int>::max()); // Never archives
+        TournamentScheduler tournament;
+        WinnerList winnersList;
+        WinnerList knockoutPlayers;
+        MatchHistoryShards shards(false, prefix);
+        HeadlessDriver driver(manager, entranceQueue, exitQueue, withdrawalQueue, tournament,
+                              winnersList, knockoutPlayers, shards);
+        failed = driver.run(filename, true);
+        driver.displayLatencyReport();
+        if (PROFILING) {
+            displayProbeStats();
+        }
+    }
+
+    for (const string& file : MatchHistoryShards::dataFiles(prefix)) {
+        remove(file.c_str());
+    }
+    return failed;
+}
+
+#ifdef DATASTRUCT_BENCHMARK
+// ===============================Benchmarks================================
+// Building with -DDATASTRUCT_BENCHMARK replaces the menu with a microbenchmark of
+// every hot operation at sizes from 10^3 up to --max-size (default 10^6, up to 10^7):
+//
+//   g++ -std=c++17 -O2 -pthread -DDATASTRUCT_BENCHMARK -o datastruct_bench DataStruct_Part2.cpp
+//   ./datastruct_bench [--max-size N] [--filter NAME]
+//
+// Each result is one JSON object per line on stdout, e.g.
+//   {"benchmark":"PriorityQueue::enqueue","size":1000,"ops":10000,"ns_per_op":812.4,
+//    "allocs_per_op":1.00,"ops_per_sec":1230921}
+// Structures are filled through their snapshot loaders, which is O(n) even where
+// the operation being measured walks the whole list. Files are written with a
+// benchmark_ prefix and removed afterwards.
+
+atomic<size_t> benchmarkAllocations(0);
+
+// Kept out of line so the compiler never sees malloc and free paired with new and delete
+#ifdef __GNUC__
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#else
+#define BENCHMARK_NOINLINE
+#endif
+
+BENCHMARK_NOINLINE void* operator new(size_t size) {
+    benchmarkAllocations.fetch_add(1, memory_order_relaxed);
+    if (void* memory = malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw bad_alloc();
+}
+
+BENCHMARK_NOINLINE void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+const string BENCHMARK_SNAPSHOT = "benchmark_snapshot.bin";
+volatile long benchmarkSink; // Results are stored here so the work cannot be optimized away
+
+// Fill target by writing its state with write and restoring it through loadSnapshot
+template <typename Target, typename Writer>
+void loadBenchmarkState(Target& target, Writer write) {
+    SnapshotWriter out;
+    out.beginSection(SNAP_SPECTATORS);
+    write(out);
+    SnapshotReader in;
+    if (!out.save(BENCHMARK_SNAPSHOT) || !in.open(BENCHMARK_SNAPSHOT)) {
+        cerr << "Error writing " << BENCHMARK_SNAPSHOT << "!" << endl;
+        exit(1);
+    }
+    SnapshotReader::Cursor cursor = in.section(SNAP_SPECTATORS);
+    target.loadSnapshot(cursor);
+    remove(BENCHMARK_SNAPSHOT.c_str());
+}
+
+void writeBenchmarkSpectators(SnapshotWriter& out, int count) {
+    out.putInt(count);
+    for (int i = 0; i < count; i++) {
+        out.putInt(i + 1);
+        out.putString("Spectator" + to_string(i + 1));
+        out.putInt(i * 3 / max(count, 1)); // Already in priority order
+        out.putString("10:00");
+    }
+}
+
+void writeBenchmarkSchedule(SnapshotWriter& out, int count) {
+    out.putInt(count);
+    for (int i = 0; i < count; i++) {
+        out.putString("Player" + to_string(2 * i));
+        out.putString("Player" + to_string(2 * i + 1));
+        out.putString("Round Robin");
+        out.putBool(true);
+        out.putBool(true);
+    }
+}
+
+void writeBenchmarkWinners(SnapshotWriter& out, int count) {
+    out.putInt(count);
+    for (int i = 0; i < count; i++) {
+        out.putString("Player" + to_string(i));
+    }
+}
+
+// Write a match log of count matches between 256 players
+void writeBenchmarkLog(const string& prefix, int count) {
+    ofstream log(prefix + "match_history.txt", ios::binary);
+    string lines;
+    for (int i = 1; i <= count; i++) {
+        int p1 = i % 256, p2 = (i * 7 + 1) % 256, s1 = i % 11, s2 = (i * 3) % 11;
+        lines += to_string(i) + ",Player" + to_string(p1) + ",Player" + to_string(p2) + "," + to_string(s1) + ","
+                 + to_string(s2) + ",Player" + to_string(s1 > s2 ? p1 : p2) + ",Round Robin,2025-01-01\n";
+        if (lines.size() > (1 << 20)) {
+            log << lines;
+            lines.clear();
+        }
+    }
+    log << lines;
+}
+
+void removeBenchmarkFiles(const string& prefix) {
+    remove((prefix + "match_history.txt").c_str());
+    remove((prefix + "player_stats.txt").c_str());
+}
+
+// Run prepare(size), which builds the structure and returns the operation, then time
+// ops calls of operation(i) and print one result line. Output from the operations
+// themselves is discarded.
+template <typename Prepare>
+void runBenchmark(const string& filter, const char* name, int size, long ops, Prepare prepare) {
+    if (!filter.empty() && string(name).find(filter) == string::npos) {
+        return;
+    }
+    NullBuffer sink;
+    streambuf* console = cout.rdbuf(&sink);
+    auto operation = prepare(size);
+    size_t allocationsBefore = benchmarkAllocations.load();
+    auto started = chrono::steady_clock::now();
+    for (long i = 0; i < ops; i++) {
+        operation(i);
+    }
+    double nanoseconds = chrono::duration<double, nano>(chrono::steady_clock::now() - started).count();
+    size_t allocations = benchmarkAllocations.load() - allocationsBefore;
+    cout.rdbuf(console);
+
+    cout << "{\"benchmark\":\"" << name << "\",\"size\":" << size << ",\"ops\":" << ops
+         << ",\"ns_per_op\":" << fixed << setprecision(1) << nanoseconds / ops
+         << ",\"allocs_per_op\":" << setprecision(2) << static_cast<double>(allocations) / ops
+         << ",\"ops_per_sec\":" << setprecision(0) << ops / (nanoseconds / 1e9) << "}" << endl;
+}
+
+void runBenchmarks(int maxSize, const string& filter) {
+    const string prefix = "benchmark_";
+    for (int size = 1000; size <= maxSize; size *= 10) {
+        // Operations that walk the whole structure get fewer calls at larger sizes
+        long linearOps = max(10L, min(static_cast<long>(size), 10000000L / size));
+        long constantOps = min(100000L, static_cast<long>(size));
+
+        runBenchmark(filter, "PriorityQueue::enqueue", size, linearOps, [](int n) {
+            auto queue = make_shared<PriorityQueue>();
+            loadBenchmarkState(*queue, [n](SnapshotWriter& out) { writeBenchmarkSpectators(out, n); });
+            return [queue](long i) { queue->enqueue(new Spectator(-1, "Walk-in", i % 3, "10:00")); };
+        });
+        runBenchmark(filter, "PriorityQueue::dequeue", size, constantOps, [](int n) {
+            auto queue = make_shared<PriorityQueue>();
+            loadBenchmarkState(*queue, [n](SnapshotWriter& out) { writeBenchmarkSpectators(out, n); });
+            return [queue](long) { delete queue->dequeue(); };
+        });
+        runBenchmark(filter, "SpectatorManager::registerSpectator", size, linearOps, [](int n) {
+            auto manager = make_shared<SpectatorManager>();
+            loadBenchmarkState(*manager, [n](SnapshotWriter& out) {
+                out.putInt(n + 1);
+                out.putInt(0);
+                writeBenchmarkSpectators(out, n);
+                out.putInt(0);
+                out.putInt(0);
+            });
+            return [manager](long i) { manager->registerSpectator("Spectator", static_cast<int>(i % 3), "10:00"); };
+        });
+        runBenchmark(filter, "SpectatorManager::hasEntered", size, linearOps, [](int n) {
+            auto manager = make_shared<SpectatorManager>();
+            loadBenchmarkState(*manager, [n](SnapshotWriter& out) {
+                out.putInt(n + 1);
+                out.putInt(0);
+                out.putInt(0);
+                writeBenchmarkSpectators(out, n);
+                out.putInt(0);
+            });
+            return [manager, n](long i) { benchmarkSink = manager->hasEntered(static_cast<int>((i * 7919) % n) + 1); };
+        });
+        runBenchmark(filter, "SpectatorManager::searchSpectator", size, linearOps, [](int n) {
+            auto manager = make_shared<SpectatorManager>();
+            loadBenchmarkState(*manager, [n](SnapshotWriter& out) {
+                out.putInt(n + 1);
+                out.putInt(0);
+                writeBenchmarkSpectators(out, n);
+                out.putInt(0);
+                out.putInt(0);
+            });
+            return [manager, n](long i) { manager->searchSpectator(static_cast<int>((i * 7919) % n) + 1); };
+        });
+        runBenchmark(filter, "TournamentScheduler::replacePlayer", size, linearOps, [](int n) {
+            auto scheduler = make_shared<TournamentScheduler>();
+            loadBenchmarkState(*scheduler, [n](SnapshotWriter& out) { writeBenchmarkSchedule(out, n); });
+            return [scheduler, n](long i) {
+                // Swap one scheduled player out and straight back in, keeping the schedule the same size
+                string player = "Player" + to_string((i / 2 * 7919) % (2L * n));
+                if (i % 2 == 0) {
+                    scheduler->replacePlayer(player, "Substitute");
+                } else {
+                    scheduler->replacePlayer("Substitute", player);
+                }
+            };
+        });
+        runBenchmark(filter, "WinnerList::addWinner", size, linearOps, [](int n) {
+            auto winners = make_shared<WinnerList>();
+            loadBenchmarkState(*winners, [n](SnapshotWriter& out) { writeBenchmarkWinners(out, n); });
+            return [winners](long) { winners->addWinner("Winner"); };
+        });
+        runBenchmark(filter, "shuffleKnockoutPlayers", size, linearOps, [](int n) {
+            auto players = make_shared<WinnerList>();
+            loadBenchmarkState(*players, [n](SnapshotWriter& out) { writeBenchmarkWinners(out, n); });
+            return [players](long) { shuffleKnockoutPlayers(*players); };
+        });
+        runBenchmark(filter, "WithdrawalQueue::processWithdrawal", size, linearOps, [linearOps](int n) {
+            auto scheduler = make_shared<TournamentScheduler>();
+            auto withdrawals = make_shared<WithdrawalQueue>(numeric_limits<int>::max()); // Never archives
+            loadBenchmarkState(*scheduler, [n](SnapshotWriter& out) { writeBenchmarkSchedule(out, n); });
+            for (long i = 0; i < linearOps; i++) {
+                string player = "Player" + to_string((i * 7919) % (2L * n));
+                withdrawals->enqueueWithdrawal(player, i % 2 ? "Substitute" + to_string(i) : "");
+            }
+            return [scheduler, withdrawals](long) { withdrawals->processWithdrawal(*scheduler); };
+        });
+        runBenchmark(filter, "PlayerStatsTable::findOrCreate", size, constantOps * 10, [](int n) {
+            auto table = make_shared<PlayerStatsTable>();
+            for (int i = 0; i < n; i++) {
+                table->findOrCreate("Player" + to_string(i));
+            }
+            auto names = make_shared<vector<string>>();
+            for (int i = 0; i < 1024; i++) {
+                names->push_back("Player" + to_string((i * 7919) % n));
+            }
+            return [table, names](long i) { benchmarkSink = table->findOrCreate((*names)[i & 1023]); };
+        });
+        // Loading is measured per match read from the log
+        runBenchmark(filter, "MatchHistoryTracker::loadFromFile", size, size, [&prefix](int n) {
+            removeBenchmarkFiles(prefix);
+            writeBenchmarkLog(prefix, n);
+            auto tracker = make_shared<unique_ptr<MatchHistoryTracker>>();
+            return [tracker, &prefix](long i) {
+                if (i == 0) tracker->reset(new MatchHistoryTracker(false, prefix));
+            };
+        });
+        runBenchmark(filter, "MatchHistoryTracker::recordMatch", size, constantOps, [&prefix](int n) {
+            removeBenchmarkFiles(prefix);
+            writeBenchmarkLog(prefix, n);
+            auto tracker = make_shared<MatchHistoryTracker>(false, prefix);
+            auto names = make_shared<vector<string>>();
+            for (int i = 0; i < 256; i++) {
+                names->push_back("Player" + to_string(i));
+            }
+            return [tracker, names](long i) {
+                tracker->recordMatch((*names)[i % 256], (*names)[(i * 7 + 1) % 256], i % 11, (i * 3) % 11, "Round Robin");
+            };
+        });
+        removeBenchmarkFiles(prefix);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int maxSize = 1000000;
+    string filter;
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--max-size" && i + 1 < argc) {
+            maxSize = min(max(atoi(argv[++i]), 1000), 10000000);
+        } else if (option == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        }
+    }
+    runBenchmarks(maxSize, filter);
+    return 0;
+}
 
+#else
 // ===============================Main Menu================================
-int main() {
+int main(int argc, char* argv[]) {
+    // --rebuild-stats: recompute player statistics from the match history on startup
+    bool rebuildStats = false;
+    int hotWindow = 0; // --hot-window N: keep only the newest N matches in memory
+    bool headless = false;
+    string commandFile; // --headless [file]: run commands from file, or stdin, without the menus
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--rebuild-stats") {
+            rebuildStats = true;
+        } else if (option == "--hot-window" && i + 1 < argc) {
+            hotWindow = max(atoi(argv[++i]), 0);
+        } else if (option == "--headless") {
+            headless = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                commandFile = argv[++i];
+            }
+        } else if (option == "--benchmark-recording") {
+            runRecordingBenchmark(i + 1 < argc ? max(atoi(argv[i + 1]), 1) : 20000);
+            return 0;
+        } else if (option == "--benchmark-readers") {
+            runReaderBenchmark();
+            return 0;
+        } else if (option == "--generate-workload" && i + 1 < argc) {
+            // Optional: spectators, bracket size (rounded down to a power of two), seed
+            string filename = argv[++i];
+            int numbers[3] = {20000, 64, 1};
+            for (int n = 0; n < 3 && i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0])); n++) {
+                numbers[n] = atoi(argv[++i]);
+            }
+            int bracketSize = 2;
+            while (bracketSize * 2 <= min(numbers[1], 1 << 16)) {
+                bracketSize *= 2;
+            }
+            return generateWorkload(filename, min(max(numbers[0], 0), 10000000), bracketSize,
+                                    static_cast<unsigned>(numbers[2])) ? 0 : 1;
+        } else if (option == "--replay-workload" && i + 1 < argc) {
+            return replayWorkload(argv[++i]) == 0 ? 0 : 1;
+        }
+    }
+
     SpectatorManager manager;
     PriorityQueue entranceQueue, exitQueue;
     WithdrawalQueue withdrawalQueue;
     TournamentScheduler tournament;
     WinnerList winnersList;
     WinnerList knockoutPlayers;
-    MatchHistoryTracker matchHistoryTracker;
+    MatchHistoryShards matchHistoryShards(rebuildStats);
+    matchHistoryShards.setHotWindow(hotWindow);
     int choice;
 
+    loadApplicationSnapshot(manager, entranceQueue, exitQueue, withdrawalQueue, tournament,
+                            winnersList, knockoutPlayers);
+
+    if (headless) {
+        HeadlessDriver driver(manager, entranceQueue, exitQueue, withdrawalQueue, tournament,
+                              winnersList, knockoutPlayers, matchHistoryShards);
+        return driver.run(commandFile) == 0 ? 0 : 1;
+    }
+
+    periodicSnapshotSave = [&]() {
+        saveApplicationSnapshot(manager, entranceQueue, exitQueue, withdrawalQueue, tournament,
+                                winnersList, knockoutPlayers);
+    };
+
     while (true) {
+        saveSnapshotIfDue();
         displayMainMenu();
-        choice = getValidatedInput(1, 5);
+        choice = getValidatedInput(1, 7);
 
-        if (choice == 5) {
+        if (choice == 5 || choice == 7) {
+            saveApplicationSnapshot(manager, entranceQueue, exitQueue, withdrawalQueue, tournament,
+                                    winnersList, knockoutPlayers);
+        }
+        if (choice == 7) {
             cout << "Exiting the program...\n";
             break;
         }
@@ -1964,7 +7470,12 @@ int main() {
                 handleWithdrawalMenu(withdrawalQueue, tournament);
                 break;
             case 4:
-                handleMatchHistoryMenu(matchHistoryTracker);
+                handleMatchHistoryMenu(matchHistoryShards);
+                break;
+            case 5:
+                break;
+            case 6:
+                reportProbeStats();
                 break;
             default:
                 cout << "Invalid option. Please try again.\n";
@@ -1973,3 +7484,4 @@ int main() {
 
     return 0;
 }
+#endif